@@ -28,13 +28,61 @@
  */
 
 #include "buffers.h"
+#include "scan.h"
+#include "uring.h"
 
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <poll.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef IOV_MAX
+    #define IOV_MAX 1024
+#endif
+
+/* max number of output writes in flight with the io_uring backend */
+#define BUFFER_URING_DEPTH 8
+
+/* completion tag of the input read, writes are tagged with their slot index + 1 */
+#define BUFFER_URING_READ_TAG 0
+
+typedef struct {
+    /* memory being written while busy, spare memory to swap with the output buffer otherwise */
+    char *data;
+    size_t size;
+
+    size_t len;
+    size_t done;
+    off_t offset;
+    int busy;
+} buffer_uring_slot_t;
+
+static struct {
+    uring_t *ring;
+
+    int in_fd;
+    int reading;
+    int read_ready;
+    int read_res;
+
+    int out_fd;
+    int out_seekable;
+    off_t out_offset;
+    unsigned writes;
+    int write_err;
+    buffer_uring_slot_t slots[BUFFER_URING_DEPTH];
+} buffer_uring = { .in_fd = -1, .out_fd = -1 };
+
+static int buffer_uring_flush(buffer_t *buffer);
+static int buffer_writev_sync(int fd, struct iovec *iov, int iovcnt);
+static int buffer_uring_drain(void);
+static int buffer_reader_fill_uring(buffer_reader_t *r);
+
 int buffer_init(buffer_t* buffer, size_t size) {
     buffer->data = calloc(size, sizeof(char));
     if (buffer->data == NULL) {
@@ -59,9 +107,15 @@ void buffer_reset(buffer_t* buffer) {
     buffer->pos = 0;
 }
 
-size_t buffer_load(buffer_t* dst, FILE* src) {
-    size_t r = fread(dst->data + dst->pos, sizeof(char), dst->size - dst->pos, src);
-    dst->pos += r;
+ssize_t buffer_load(buffer_t* dst, int fd) {
+    ssize_t r;
+    do {
+        r = read(fd, dst->data + dst->pos, dst->size - dst->pos);
+    } while (r == -1 && errno == EINTR);
+
+    if (r > 0) {
+        dst->pos += r;
+    }
     return r;
 }
 
@@ -69,14 +123,95 @@ size_t buffer_available(buffer_t *buffer) {
     return buffer->size - buffer->pos;
 }
 
-int buffer_flush(FILE* dst, buffer_t* buffer) {
-    if (fwrite(buffer->data, sizeof(char), buffer->pos, dst) < buffer->pos) {
-        if (ferror(dst) > 0) {
+int buffer_flush(int fd, buffer_t* buffer) {
+    if (buffer_uring.ring != NULL && fd == buffer_uring.out_fd) {
+        return buffer_uring_flush(buffer);
+    }
+
+    struct iovec iov = { buffer->data, buffer->pos };
+    return buffer_writev(fd, &iov, 1);
+}
+
+int buffer_write(int fd, buffer_t *buffer, const char *data, size_t len) {
+    while (len > 0) {
+        if (buffer_available(buffer) == 0) {
+            int r = buffer_flush(fd, buffer);
+            if (r != BUFFER_SUCCESS) {
+                return r;
+            }
+            buffer_reset(buffer);
+        }
+
+        size_t n = buffer_available(buffer) < len ? buffer_available(buffer) : len;
+        memcpy(buffer->data + buffer->pos, data, n);
+        buffer->pos += n;
+        data += n;
+        len -= n;
+    }
+    return BUFFER_SUCCESS;
+}
+
+/*
+ * Waits until fd can be written again, for non-blocking descriptors.
+ */
+static int buffer_wait_writable(int fd) {
+    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+    int r;
+    do {
+        r = poll(&pfd, 1, -1);
+    } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+int buffer_writev(int fd, struct iovec *iov, int iovcnt) {
+    int uring_out = buffer_uring.ring != NULL && fd == buffer_uring.out_fd;
+    if (uring_out) {
+        /* asynchronous writes must land first to keep the output ordered */
+        if (buffer_uring_drain() != BUFFER_SUCCESS) {
+            return BUFFER_FLUSH_ERROR;
+        }
+    }
+
+    int r = buffer_writev_sync(fd, iov, iovcnt);
+
+    if (uring_out && buffer_uring.out_seekable) {
+        buffer_uring.out_offset = lseek(fd, 0, SEEK_CUR);
+    }
+    return r;
+}
+
+static int buffer_writev_sync(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        /* skip what has been written completely */
+        if (iov->iov_len == 0) {
+            iov++;
+            iovcnt--;
+            continue;
+        }
+
+        ssize_t w = writev(fd, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+        if (w == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && buffer_wait_writable(fd) > 0) {
+                continue;
+            }
             fprintf(stderr, "Error: bufflush: unable to flush buffer: %s\n", strerror(errno));
-        } else {
-            fprintf(stderr, "Error: bufflush: unable to flush buffer\n");
+            return BUFFER_FLUSH_ERROR;
+        }
+
+        /* partial write: advance past the vectors written so far */
+        while (w > 0) {
+            size_t n = (size_t)w < iov->iov_len ? (size_t)w : iov->iov_len;
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+            w -= n;
+            if (iov->iov_len == 0) {
+                iov++;
+                iovcnt--;
+            }
         }
-        return BUFFER_FLUSH_ERROR;
     }
 
     return BUFFER_SUCCESS;
@@ -92,21 +227,601 @@ int buffer_extend(buffer_t* buffer, size_t newsize) {
     }
 
     char *newbuf = realloc(buffer->data, newsize);
-
-    /* ensure added capacity is 0-filled */
-    memset(newbuf + buffer->size, 0, newsize - buffer->size);
-
     if (newbuf == NULL) {
         perror("buffer_extend");
         return BUFFER_MEM_ERROR;
     }
 
+    /* ensure added capacity is 0-filled */
+    memset(newbuf + buffer->size, 0, newsize - buffer->size);
+
     buffer->data = newbuf;
     buffer->size = newsize;
 
     return BUFFER_SUCCESS;
 }
 
+int buffer_reader_init(buffer_reader_t *reader, int fd, size_t size) {
+    memset(reader, 0, sizeof(buffer_reader_t));
+    reader->fd = fd;
+    reader->end = SIZE_MAX;
+
+    return buffer_init(&reader->buf, size);
+}
+
+void buffer_reader_init_mapped(buffer_reader_t *reader, void *map, size_t maplen, size_t offset) {
+    memset(reader, 0, sizeof(buffer_reader_t));
+    reader->map = map;
+    reader->maplen = maplen;
+    reader->fd = -1;
+    reader->base = offset;
+    reader->end = SIZE_MAX;
+
+    /* the whole input is already in the window: it will never be refilled */
+    reader->buf.data = (char*)map + offset;
+    reader->buf.size = maplen - offset;
+    reader->buf.pos = maplen - offset;
+    reader->eof = 1;
+}
+
+void buffer_reader_free(buffer_reader_t *reader) {
+    if (reader->map != NULL) {
+        munmap(reader->map, reader->maplen);
+        reader->map = NULL;
+        reader->buf.data = NULL;
+        return;
+    }
+    buffer_free(&reader->buf);
+}
+
+/*
+ * Moves the unfinished item to the beginning of the window and reads more input after it.
+ * The window only grows when a single item does not fit in it.
+ */
+static int buffer_reader_compact(buffer_reader_t *r) {
+    if (r->start > 0) {
+        r->base += r->start;
+        memmove(r->buf.data, r->buf.data + r->start, r->buf.pos - r->start);
+        r->buf.pos -= r->start;
+        r->scanned -= r->start;
+        r->start = 0;
+    }
+
+    if (buffer_available(&r->buf) == 0) {
+        if (buffer_extend(&r->buf, r->buf.size * 2) != BUFFER_SUCCESS) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int buffer_reader_fill(buffer_reader_t *r) {
+    if (buffer_uring.ring != NULL && r->fd >= 0 && r->fd == buffer_uring.in_fd) {
+        return buffer_reader_fill_uring(r);
+    }
+
+    if (buffer_reader_compact(r) != 0) {
+        return -1;
+    }
+
+    if (r->idle != NULL) {
+        struct pollfd pfd = { .fd = r->fd, .events = POLLIN };
+        int ready;
+        do {
+            ready = poll(&pfd, 1, r->idle_ms);
+        } while (ready == -1 && errno == EINTR);
+
+        if (ready == 0 && r->idle(r->idle_ctx) != 0) {
+            return -1;
+        }
+    }
+
+    ssize_t n = buffer_load(&r->buf, r->fd);
+    if (n == -1) {
+        fprintf(stderr, "Error: unable to read input: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (n == 0) {
+        r->eof = 1;
+    }
+
+    return 0;
+}
+
+ssize_t buffer_reader_next_block(buffer_reader_t *r, const char **block) {
+    while (r->start == r->buf.pos && !r->eof) {
+        if (buffer_reader_fill(r) != 0) {
+            return -1;
+        }
+    }
+
+    size_t len = r->buf.pos - r->start;
+    *block = r->buf.data + r->start;
+
+    /* all consumed: the next fill starts from the beginning of the window */
+    r->start = r->buf.pos;
+    r->scanned = r->buf.pos;
+    r->nsep = 0;
+    r->cur = 0;
+    return len;
+}
+
+void buffer_reader_set_idle(buffer_reader_t *r, int (*idle)(void *ctx), void *ctx, int idle_ms) {
+    r->idle = idle;
+    r->idle_ctx = ctx;
+    r->idle_ms = idle_ms;
+}
+
+int buffer_reader_set_range(buffer_reader_t *r, size_t start, size_t end, size_t separator_len) {
+    /*
+     * the item starting at start (if any) is preceded by a separator:
+     * begin right before it and drop whatever comes first, which belongs to the previous range
+     */
+    size_t from = start > separator_len ? start - separator_len : 0;
+    r->skip_first = start > 0;
+    r->end = end;
+
+    if (r->map != NULL) {
+        if (from > r->maplen) {
+            from = r->maplen;
+        }
+        r->buf.data = (char*)r->map + from;
+        r->buf.size = r->maplen - from;
+        r->buf.pos = r->maplen - from;
+    } else {
+        if (lseek(r->fd, from, SEEK_SET) == -1) {
+            return -1;
+        }
+        r->buf.pos = 0;
+        r->eof = 0;
+    }
+
+    r->base = from;
+    r->start = 0;
+    r->scanned = 0;
+    r->nsep = 0;
+    r->cur = 0;
+
+    return 0;
+}
+
+static int buffer_reader_next_item(buffer_reader_t *r, const char *separator, size_t separator_len,
+                                   const char **item, size_t *len) {
+    for (;;) {
+        if (r->cur < r->nsep) {
+            size_t end = r->offsets[r->cur++];
+            *item = r->buf.data + r->start;
+            *len = end - r->start;
+            r->start = end + separator_len;
+            return 1;
+        }
+
+        if (r->scanned < r->buf.pos) {
+            /* only scan what has not been scanned before */
+            size_t base = r->scanned;
+            r->nsep = scan_separators_str(r->buf.data + base, r->buf.pos - base, separator, separator_len,
+                                          r->offsets, BUFFER_READER_BATCH_SIZE);
+            r->cur = 0;
+            for (size_t k = 0; k < r->nsep; k++) {
+                r->offsets[k] += base;
+            }
+
+            size_t last_end = r->nsep > 0 ? r->offsets[r->nsep - 1] + separator_len : base;
+            if (r->nsep == BUFFER_READER_BATCH_SIZE) {
+                r->scanned = last_end;
+            } else {
+                /* a separator might be cut by the end of the window: rescan its first bytes after the refill */
+                size_t partial = separator_len - 1;
+                r->scanned = r->buf.pos > partial ? r->buf.pos - partial : 0;
+                if (r->scanned < last_end) {
+                    r->scanned = last_end;
+                }
+            }
+
+            if (r->nsep > 0) {
+                continue;
+            }
+        }
+
+        if (r->eof) {
+            if (r->start < r->buf.pos) {
+                /* the input does not end with a separator: the remaining bytes are the last item */
+                *item = r->buf.data + r->start;
+                *len = r->buf.pos - r->start;
+                r->start = r->buf.pos;
+                return 1;
+            }
+            return 0;
+        }
+
+        if (buffer_reader_fill(r) != 0) {
+            return -1;
+        }
+    }
+}
+
+void buffer_reader_set_frame(buffer_reader_t *r, buffer_frame_t frame) {
+    r->frame = frame;
+}
+
+size_t buffer_frame_header(buffer_frame_t frame, size_t len, char *dst) {
+    unsigned char *p = (unsigned char*)dst;
+    switch (frame) {
+        case BUFFER_FRAME_VARINT: {
+            size_t n = 0;
+            while (len >= 0x80) {
+                p[n++] = (unsigned char)(len | 0x80);
+                len >>= 7;
+            }
+            p[n++] = (unsigned char)len;
+            return n;
+        }
+        case BUFFER_FRAME_U32LE:
+        case BUFFER_FRAME_U32BE:
+            if (len > UINT32_MAX) {
+                return 0;
+            }
+            for (int i = 0; i < 4; i++) {
+                int shift = frame == BUFFER_FRAME_U32LE ? 8 * i : 8 * (3 - i);
+                p[i] = (unsigned char)(len >> shift);
+            }
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+int buffer_frame_parse(buffer_frame_t frame, const char *data, size_t avail, size_t *hdrlen, size_t *len) {
+    const unsigned char *p = (const unsigned char*)data;
+    switch (frame) {
+        case BUFFER_FRAME_VARINT: {
+            uint64_t v = 0;
+            for (size_t n = 0; n < BUFFER_FRAME_MAX_HEADER; n++) {
+                if (n == avail) {
+                    return 0;
+                }
+                if (n == BUFFER_FRAME_MAX_HEADER - 1 && p[n] > 1) {
+                    /* more than 64 bits */
+                    return -1;
+                }
+                v |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+                if ((p[n] & 0x80) == 0) {
+#if SIZE_MAX < UINT64_MAX
+                    if (v > SIZE_MAX) {
+                        return -1;
+                    }
+#endif
+                    *hdrlen = n + 1;
+                    *len = (size_t)v;
+                    return 1;
+                }
+            }
+            return -1;
+        }
+        case BUFFER_FRAME_U32LE:
+        case BUFFER_FRAME_U32BE: {
+            if (avail < 4) {
+                return 0;
+            }
+            uint32_t v = 0;
+            for (int i = 0; i < 4; i++) {
+                int shift = frame == BUFFER_FRAME_U32LE ? 8 * i : 8 * (3 - i);
+                v |= (uint32_t)p[i] << shift;
+            }
+            *hdrlen = 4;
+            *len = v;
+            return 1;
+        }
+        default:
+            return -1;
+    }
+}
+
+static int buffer_reader_next_frame(buffer_reader_t *r, const char **item, size_t *len) {
+    for (;;) {
+        size_t avail = r->buf.pos - r->start;
+        size_t hdrlen = 0;
+        size_t n = 0;
+
+        int parsed = buffer_frame_parse(r->frame, r->buf.data + r->start, avail, &hdrlen, &n);
+        if (parsed < 0) {
+            fprintf(stderr, "Error: invalid record length at input offset %zu\n", r->base + r->start);
+            return -1;
+        }
+
+        if (parsed > 0 && avail - hdrlen >= n) {
+            *item = r->buf.data + r->start + hdrlen;
+            *len = n;
+            r->start += hdrlen + n;
+
+            /* nothing is ever scanned for separators: keep compaction from underflowing */
+            r->scanned = r->start;
+            return 1;
+        }
+
+        if (r->eof) {
+            if (avail == 0) {
+                return 0;
+            }
+            fprintf(stderr, "Error: truncated record at input offset %zu\n", r->base + r->start);
+            return -1;
+        }
+
+        /* the window grows on refills until the whole record fits */
+        if (buffer_reader_fill(r) != 0) {
+            return -1;
+        }
+    }
+}
+
+int buffer_reader_next(buffer_reader_t *r, const char *separator, size_t separator_len,
+                       const char **item, size_t *len) {
+    if (r->frame != BUFFER_FRAME_NONE) {
+        return buffer_reader_next_frame(r, item, len);
+    }
+
+    for (;;) {
+        /* refills move the window but keep base + start unchanged */
+        size_t at = r->base + r->start;
+
+        int found = buffer_reader_next_item(r, separator, separator_len, item, len);
+        if (found <= 0) {
+            return found;
+        }
+
+        if (at >= r->end) {
+            return 0;
+        }
+
+        if (r->skip_first) {
+            r->skip_first = 0;
+            continue;
+        }
+        return 1;
+    }
+}
+
+/*
+ * io_uring backend.
+ *
+ * Input: the next read is submitted as soon as the previous one completes,
+ * straight into the free part of the reader window, so the kernel fills it
+ * while the items already read are being split and mapped.
+ *
+ * Output: a flushed buffer is handed over to a write slot and the output buffer
+ * gets the slot spare memory in exchange, so mapping goes on while the write is
+ * in flight. Writes to regular files carry their own offset and up to
+ * BUFFER_URING_DEPTH of them can be in flight at once; pipes and files opened
+ * for appending get a single write in flight, as concurrent writes to them
+ * could land out of order.
+ */
+
+int buffer_uring_enable(int in_fd, int out_fd) {
+    if (buffer_uring.ring != NULL) {
+        return 1;
+    }
+
+    buffer_uring.ring = uring_create(BUFFER_URING_DEPTH * 2);
+    if (buffer_uring.ring == NULL) {
+        return 0;
+    }
+
+    buffer_uring.in_fd = in_fd;
+    buffer_uring.out_fd = out_fd;
+
+    struct stat st;
+    int flags = fcntl(out_fd, F_GETFL);
+    off_t offset = lseek(out_fd, 0, SEEK_CUR);
+    buffer_uring.out_seekable = fstat(out_fd, &st) == 0 && S_ISREG(st.st_mode)
+        && flags != -1 && (flags & O_APPEND) == 0 && offset != -1;
+    buffer_uring.out_offset = offset;
+
+    return 1;
+}
+
+void buffer_uring_disable(void) {
+    if (buffer_uring.ring == NULL) {
+        return;
+    }
+
+    buffer_uring_drain();
+
+    /*
+     * a read still in flight (e.g. when giving up before the end of the input)
+     * is cancelled by tearing the ring down
+     */
+    uring_destroy(buffer_uring.ring);
+    buffer_uring.ring = NULL;
+
+    for (int i = 0; i < BUFFER_URING_DEPTH; i++) {
+        free(buffer_uring.slots[i].data);
+        buffer_uring.slots[i].data = NULL;
+        buffer_uring.slots[i].size = 0;
+    }
+    buffer_uring.in_fd = -1;
+    buffer_uring.out_fd = -1;
+}
+
+static int buffer_uring_submit_write(int slot) {
+    buffer_uring_slot_t *s = &buffer_uring.slots[slot];
+    int64_t offset = buffer_uring.out_seekable ? (int64_t)(s->offset + s->done) : URING_CUR_POS;
+
+    if (uring_write(buffer_uring.ring, buffer_uring.out_fd, s->data + s->done, s->len - s->done,
+                    offset, slot + 1) != 0 || uring_submit(buffer_uring.ring) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Waits for the next completion and updates the state of the operation it belongs to.
+ */
+static int buffer_uring_reap(void) {
+    uint64_t tag;
+    int res;
+    if (uring_wait(buffer_uring.ring, &tag, &res) != 0) {
+        fprintf(stderr, "Error: io_uring: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (tag == BUFFER_URING_READ_TAG) {
+        buffer_uring.reading = 0;
+        buffer_uring.read_ready = 1;
+        buffer_uring.read_res = res;
+        return 0;
+    }
+
+    int slot = (int)(tag - 1);
+    buffer_uring_slot_t *s = &buffer_uring.slots[slot];
+
+    if (res == -EINTR || res == -EAGAIN) {
+        return buffer_uring_submit_write(slot);
+    }
+
+    if (res > 0) {
+        s->done += res;
+        if (s->done < s->len) {
+            /* partial write: resume where it stopped before releasing the slot */
+            return buffer_uring_submit_write(slot);
+        }
+    } else if (buffer_uring.write_err == 0) {
+        buffer_uring.write_err = res < 0 ? -res : EIO;
+    }
+
+    s->busy = 0;
+    buffer_uring.writes--;
+    return 0;
+}
+
+static int buffer_uring_check_writes(void) {
+    if (buffer_uring.write_err != 0) {
+        fprintf(stderr, "Error: bufflush: unable to flush buffer: %s\n", strerror(buffer_uring.write_err));
+        return BUFFER_FLUSH_ERROR;
+    }
+    return BUFFER_SUCCESS;
+}
+
+static int buffer_uring_drain(void) {
+    while (buffer_uring.writes > 0) {
+        if (buffer_uring_reap() != 0) {
+            return BUFFER_FLUSH_ERROR;
+        }
+    }
+
+    if (buffer_uring.out_seekable) {
+        /* writes at explicit offsets do not move the file position */
+        lseek(buffer_uring.out_fd, buffer_uring.out_offset, SEEK_SET);
+    }
+
+    return buffer_uring_check_writes();
+}
+
+static int buffer_uring_flush(buffer_t *buffer) {
+    if (buffer->pos == 0) {
+        return buffer_uring_check_writes();
+    }
+
+    unsigned max_writes = buffer_uring.out_seekable ? BUFFER_URING_DEPTH : 1;
+    while (buffer_uring.writes >= max_writes) {
+        if (buffer_uring_reap() != 0) {
+            return BUFFER_FLUSH_ERROR;
+        }
+    }
+
+    if (buffer_uring_check_writes() != BUFFER_SUCCESS) {
+        return BUFFER_FLUSH_ERROR;
+    }
+
+    int slot = 0;
+    while (buffer_uring.slots[slot].busy) {
+        slot++;
+    }
+    buffer_uring_slot_t *s = &buffer_uring.slots[slot];
+
+    if (s->size != buffer->size) {
+        char *spare = realloc(s->data, buffer->size);
+        if (spare == NULL) {
+            perror("buffer_flush");
+            return BUFFER_MEM_ERROR;
+        }
+        s->data = spare;
+        s->size = buffer->size;
+    }
+
+    /* the slot now owns the data to write, the buffer takes the spare memory */
+    char *data = buffer->data;
+    buffer->data = s->data;
+    s->data = data;
+
+    s->len = buffer->pos;
+    s->done = 0;
+    s->offset = buffer_uring.out_offset;
+    s->busy = 1;
+    buffer_uring.writes++;
+
+    if (buffer_uring.out_seekable) {
+        buffer_uring.out_offset += s->len;
+    }
+
+    if (buffer_uring_submit_write(slot) != 0) {
+        fprintf(stderr, "Error: bufflush: unable to submit write: %s\n", strerror(errno));
+        return BUFFER_FLUSH_ERROR;
+    }
+    return BUFFER_SUCCESS;
+}
+
+static int buffer_uring_submit_read(buffer_reader_t *r) {
+    if (uring_read(buffer_uring.ring, r->fd, r->buf.data + r->buf.pos, buffer_available(&r->buf),
+                   URING_CUR_POS, BUFFER_URING_READ_TAG) != 0 || uring_submit(buffer_uring.ring) != 0) {
+        fprintf(stderr, "Error: unable to read input: %s\n", strerror(errno));
+        return -1;
+    }
+    buffer_uring.reading = 1;
+    return 0;
+}
+
+static int buffer_reader_fill_uring(buffer_reader_t *r) {
+    for (;;) {
+        if (!buffer_uring.reading && !buffer_uring.read_ready) {
+            /* first read: nothing has been read ahead yet */
+            if (buffer_reader_compact(r) != 0 || buffer_uring_submit_read(r) != 0) {
+                return -1;
+            }
+        }
+
+        while (buffer_uring.reading) {
+            if (buffer_uring_reap() != 0) {
+                return -1;
+            }
+        }
+        buffer_uring.read_ready = 0;
+
+        if (buffer_uring.read_res != -EINTR && buffer_uring.read_res != -EAGAIN) {
+            break;
+        }
+    }
+
+    if (buffer_uring.read_res < 0) {
+        fprintf(stderr, "Error: unable to read input: %s\n", strerror(-buffer_uring.read_res));
+        return -1;
+    }
+
+    if (buffer_uring.read_res == 0) {
+        r->eof = 1;
+        return 0;
+    }
+
+    r->buf.pos += buffer_uring.read_res;
+
+    /* read ahead into the free part of the window while the caller splits what just arrived */
+    if (buffer_reader_compact(r) != 0) {
+        return -1;
+    }
+    return buffer_uring_submit_read(r);
+}
+
 size_t calc_iobufsize(enum buf_type_t buftype, size_t fallback_size) {
     struct stat s;
 
@@ -32,6 +32,7 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <sys/uio.h>
 
 enum buf_type_t {
     BUF_STDIN,
@@ -45,20 +46,182 @@ typedef enum {
     BUFFER_SIZE_TOO_SHORT
 } buffer_result_t;
 
+/*
+ * Length prefixes of framed records: each record is its length followed by its raw bytes,
+ * so records may contain any byte and need no separator.
+ */
+typedef enum {
+    BUFFER_FRAME_NONE = 0,
+    BUFFER_FRAME_VARINT,    /* unsigned LEB128, as in protobuf */
+    BUFFER_FRAME_U32LE,     /* 4 bytes, little endian */
+    BUFFER_FRAME_U32BE      /* 4 bytes, big endian */
+} buffer_frame_t;
+
+/* longest length prefix: a 64-bit varint */
+#define BUFFER_FRAME_MAX_HEADER 10
+
 typedef struct {
     char *data;
-    int pos;
+    size_t pos;
     size_t size;
 } buffer_t;
 
+/* max number of item boundaries collected by a single separator scan */
+#define BUFFER_READER_BATCH_SIZE 256
+
+/*
+ * Sliding window over an input stream, splitting it into items.
+ * Bytes of an item not terminated yet are carried over across refills,
+ * so that items spanning two reads are returned whole.
+ */
+typedef struct {
+    buffer_t buf;
+    int fd;
+
+    /* start of the first item not returned yet */
+    size_t start;
+
+    /* offset in the input of the first byte of the window */
+    size_t base;
+
+    /* items starting at or past this input offset are not returned (see buffer_reader_set_range) */
+    size_t end;
+    int skip_first;
+
+    /* bytes before this position have been scanned for separators already */
+    size_t scanned;
+
+    /* separator offsets found by the last scan, and the next one to return */
+    size_t offsets[BUFFER_READER_BATCH_SIZE];
+    size_t nsep;
+    size_t cur;
+
+    int eof;
+
+    /* when set, items are length prefixed records rather than separated (see buffer_reader_set_frame) */
+    buffer_frame_t frame;
+
+    /*
+     * if set, called with idle_ctx whenever no input arrives within idle_ms
+     * while waiting for more of it (see buffer_reader_set_idle)
+     */
+    int (*idle)(void *ctx);
+    void *idle_ctx;
+    int idle_ms;
+
+    /* set when buf.data points into a memory mapped file rather than an allocated window */
+    void *map;
+    size_t maplen;
+} buffer_reader_t;
+
 int buffer_init(buffer_t *buffer, size_t size);
 void buffer_free(buffer_t *buffer);
 void buffer_reset(buffer_t *buffer);
-size_t buffer_load(buffer_t *dst, FILE *src);
 size_t buffer_available(buffer_t *buffer);
-int buffer_flush(FILE *dst, buffer_t *buffer);
 int buffer_extend(buffer_t *buffer, size_t newsize);
 
+/*
+ * Reads from fd into the available space of dst with a single read(2),
+ * retrying if interrupted by a signal.
+ * Returns the number of bytes read, 0 at the end of the input or -1 on error.
+ */
+ssize_t buffer_load(buffer_t *dst, int fd);
+
+/*
+ * Writes the content of buffer to fd, handling partial writes.
+ *
+ * With the io_uring backend enabled for fd, the write is only submitted and
+ * buffer->data is replaced with other memory of the same size:
+ * callers must not expect the buffer content to survive a flush.
+ */
+int buffer_flush(int fd, buffer_t *buffer);
+
+/*
+ * Appends len bytes of data to buffer, flushing it to fd whenever it fills up.
+ */
+int buffer_write(int fd, buffer_t *buffer, const char *data, size_t len);
+
+/*
+ * Writes all the iovcnt vectors in iov to fd, with as few writev(2) calls as possible.
+ * Partial writes are resumed where they stopped. iov is modified in the process.
+ */
+int buffer_writev(int fd, struct iovec *iov, int iovcnt);
+
+int buffer_reader_init(buffer_reader_t *reader, int fd, size_t size);
+
+/*
+ * Initializes reader to split the maplen bytes mapped at map, starting at offset,
+ * directly over the mapping: no reads nor copies are ever needed.
+ * The reader takes ownership of the mapping.
+ */
+void buffer_reader_init_mapped(buffer_reader_t *reader, void *map, size_t maplen, size_t offset);
+void buffer_reader_free(buffer_reader_t *reader);
+
+/*
+ * Restricts reader to the items whose first byte falls in [start, end) of the input,
+ * which must be seekable. The last item is returned whole even if it extends past end:
+ * like Hadoop input splits, consecutive ranges cover the input without overlapping.
+ * Must be called before the first buffer_reader_next.
+ */
+int buffer_reader_set_range(buffer_reader_t *reader, size_t start, size_t end, size_t separator_len);
+
+/*
+ * Has reader call idle(ctx) when the input stays quiet for idle_ms milliseconds
+ * while more of it is needed, e.g. to flush pending output when tailing a slow producer.
+ * A non-zero return value from idle is reported as a read error.
+ */
+void buffer_reader_set_idle(buffer_reader_t *reader, int (*idle)(void *ctx), void *ctx, int idle_ms);
+
+/*
+ * Has reader return the records framed as frame rather than splitting the input
+ * on separators. Must be called before the first buffer_reader_next and not used with ranges.
+ */
+void buffer_reader_set_frame(buffer_reader_t *reader, buffer_frame_t frame);
+
+/*
+ * Encodes len as a frame length prefix into dst, which must hold BUFFER_FRAME_MAX_HEADER bytes.
+ * Returns the length of the prefix, or 0 if len does not fit the frame format.
+ */
+size_t buffer_frame_header(buffer_frame_t frame, size_t len, char *dst);
+
+/*
+ * Decodes the frame length prefix at the beginning of the avail bytes of data into
+ * hdrlen and len. Returns 1 on success, 0 if more bytes are needed or -1 if the prefix is invalid.
+ */
+int buffer_frame_parse(buffer_frame_t frame, const char *data, size_t avail, size_t *hdrlen, size_t *len);
+
+/*
+ * Makes block point to the input not returned yet, as it comes, regardless of items:
+ * the rest of the mapping for mapped readers, the next read otherwise.
+ * Returns the length of block, 0 at the end of the input or -1 on error.
+ * Not to be mixed with buffer_reader_next, nor used with ranges.
+ */
+ssize_t buffer_reader_next_block(buffer_reader_t *reader, const char **block);
+
+/*
+ * Makes item point to the next item in the input, terminated by the separator_len bytes
+ * of separator or by the end of the input, and sets len to its length.
+ * Framed readers ignore separator and return the next record instead.
+ * The item is only valid until the next call.
+ *
+ * Returns 1 if an item was found, 0 at the end of the input or -1 on error.
+ */
+int buffer_reader_next(buffer_reader_t *reader, const char *separator, size_t separator_len,
+                       const char **item, size_t *len);
+
+/*
+ * Enables the io_uring backend, if the running kernel supports it, for reads
+ * of buffer readers on in_fd and for buffer_flush/buffer_writev on out_fd.
+ * Pass -1 as in_fd to use it for the output only.
+ * Returns 1 if enabled, 0 if the regular read(2)/write(2) path stays in use.
+ */
+int buffer_uring_enable(int in_fd, int out_fd);
+
+/*
+ * Waits for any write in flight and releases the io_uring backend.
+ */
+void buffer_uring_disable(void);
+
 /*
  * Computes a buffer size appropriate on the current system
  * and returns fallback_size if an appropriate size cannot be determined.
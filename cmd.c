@@ -27,6 +27,9 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* splice(2) and F_SETPIPE_SZ are Linux specific */
+#define _GNU_SOURCE
+
 #include "cmd.h"
 
 #include <unistd.h>
@@ -35,18 +38,45 @@
 #include <stdio.h>
 #include <string.h>
 #include <fcntl.h>
+#include <sys/wait.h>
+#include <poll.h>
+
+/* pipe size requested for the command output, so that large values need fewer round trips */
+#define CMD_PIPE_SIZE (1 << 20)
+
+/*
+ * Reports that the command could not be executed and exits the child process,
+ * without going through stdio or the atexit handlers of the parent.
+ */
+static void _runcmd_failed(const char *cmd) {
+    static const char msg[] = "Error executing command: ";
+    ssize_t r = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    r = write(STDERR_FILENO, cmd, strlen(cmd));
+    r = write(STDERR_FILENO, "\n", 1);
+    (void)r;
+    _exit(127);
+}
 
 cmd_stream_t* runcmd(int argc, char *argv[]) {
     if (argc == 0) {
         return NULL;
     }
 
+    /*
+     * close-on-exec from the start: a command forked concurrently by another
+     * worker must not inherit, and hold open, the write end of this pipe
+     */
     int pipefd[2];
-    if (pipe(pipefd) == -1) {
+    if (pipe2(pipefd, O_CLOEXEC) == -1) {
         fprintf(stderr, "Error creating pipe: %s\n", strerror(errno));
         return NULL;
     }
 
+#ifdef F_SETPIPE_SZ
+    /* best effort: the size might exceed what unprivileged processes are allowed */
+    fcntl(pipefd[0], F_SETPIPE_SZ, CMD_PIPE_SIZE);
+#endif
+
     cmd_stream_t *cmd = malloc(sizeof(cmd_stream_t));
     if (cmd == NULL) {
         perror("runcmd");
@@ -69,26 +99,79 @@ cmd_stream_t* runcmd(int argc, char *argv[]) {
         close(pipefd[1]);
 
         execvp(argv[0], argv);
-        // If execvp returns, there was an error
-        fprintf(stderr, "Error executing command: %s\n", strerror(errno));
-        exit(EXIT_FAILURE);
+        /*
+         * If execvp returns, there was an error. Other threads of the parent may have
+         * been holding the stdio locks when forking: only write(2) and _exit from here.
+         */
+        _runcmd_failed(argv[0]);
     }
 
     // Parent process
     close(pipefd[1]);  // Close write end
-    FILE *fp = fdopen(pipefd[0], "r");
-    if (fp == NULL) {
-        fprintf(stderr, "Error creating file stream: %s\n", strerror(errno));
-        close(pipefd[0]);
-        return NULL;
-    }
 
     cmd->pid = pid;
-    cmd->s = fp;
+    cmd->fd = pipefd[0];
+    cmd->eof = 0;
+    cmd->err = 0;
 
     return cmd;
 }
 
+size_t readcmd(cmd_stream_t *cmd, char *dst, size_t max) {
+    ssize_t r;
+    do {
+        r = read(cmd->fd, dst, max);
+    } while (r == -1 && errno == EINTR);
+
+    if (r == -1) {
+        cmd->err = 1;
+        return 0;
+    }
+
+    if (r == 0 && max > 0) {
+        cmd->eof = 1;
+    }
+    return r;
+}
+
+ssize_t splicecmd(cmd_stream_t *cmd, int fd, size_t max) {
+#ifdef __linux__
+    ssize_t r;
+    for (;;) {
+        r = splice(cmd->fd, NULL, fd, NULL, max, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (r >= 0 || errno == EINTR) {
+            if (r >= 0) {
+                break;
+            }
+            continue;
+        }
+
+        if (errno == EAGAIN) {
+            /* fd is non-blocking and full */
+            struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+            poll(&pfd, 1, -1);
+            continue;
+        }
+
+        if (errno != EINVAL && errno != ENOSYS) {
+            cmd->err = 1;
+        }
+        return -1;
+    }
+
+    if (r == 0 && max > 0) {
+        cmd->eof = 1;
+    }
+    return r;
+#else
+    (void)cmd;
+    (void)fd;
+    (void)max;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 int closecmd(cmd_stream_t *cmd) {
     int status = 0;
     
@@ -96,9 +179,9 @@ int closecmd(cmd_stream_t *cmd) {
         return -1;
     }
     
-    if (cmd->s != NULL) {
-        fclose(cmd->s);
-        cmd->s = NULL;
+    if (cmd->fd >= 0) {
+        close(cmd->fd);
+        cmd->fd = -1;
     }
     
     if (cmd->pid > 0) {
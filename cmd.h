@@ -36,17 +36,38 @@
 
 typedef struct {
     pid_t pid;
-    FILE *s;
+
+    /* read end of the pipe connected to the command standard output */
+    int fd;
+
+    int eof;
+    int err;
 } cmd_stream_t;
 
 /* 
  * Runs the given command and returns a stream to
  * the command standard output.
  * 
- * Note: it's the caller's responsibility to pclose the stream.
+ * Note: it's the caller's responsibility to closecmd the stream.
  */
 cmd_stream_t* runcmd(int argc, char *argv[]);
 
+/*
+ * Reads at most max bytes of the command output into dst,
+ * retrying if interrupted by a signal.
+ * Sets the eof and err flags of cmd_stream accordingly.
+ */
+size_t readcmd(cmd_stream_t *cmd_stream, char *dst, size_t max);
+
+/*
+ * Moves at most max bytes of the command output to fd, which must be a pipe,
+ * without copying them through user space (Linux only).
+ * Returns the number of bytes moved, 0 at the end of the output or -1 on failure.
+ * Failures leave the err flag unset when splicing is just not possible,
+ * in which case the output can still be consumed with readcmd.
+ */
+ssize_t splicecmd(cmd_stream_t *cmd_stream, int fd, size_t max);
+
 int closecmd(cmd_stream_t *cmd_stream);
 
 #endif // CMD_H
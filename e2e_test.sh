@@ -74,7 +74,7 @@ run_error_test() {
 # Create test files
 echo "Creating test files..."
 echo -n "test content" > test_file.txt
-echo "multi-line\ntest\ncontent" > test_multiline.txt
+echo -e "multi-line\ntest\ncontent" > test_multiline.txt
 echo -en "@REPLACE_ME@:\nLove\nis\nall\nyou\nneed" > test_file_replstr.txt
 
 # -----------------
@@ -87,6 +87,14 @@ run_test "Basic static value" "./map --discard-input -v 'mapped'" "mapped\nmappe
 # Test with file value (--value-file flag)
 run_test "Basic file value" "./map --discard-input --value-file test_file.txt" "test content\ntest content\n" "line1\nline2\n"
 
+# Large value files are copied by the kernel where possible: the output must not depend on where it goes
+seq 20000 > test_large_value.txt
+expected_large_value=$(cat test_large_value.txt; echo; cat test_large_value.txt)
+run_test "Large file value to a pipe" "./map --value-file test_large_value.txt | cat" "$expected_large_value" "line1\nline2\n"
+run_test "Large file value to a file" "./map --value-file test_large_value.txt > test_output_value.txt; cat test_output_value.txt" "$expected_large_value" "line1\nline2\n"
+run_test "Large file value appended to a file" "rm -f test_output_value.txt; ./map --value-file test_large_value.txt >> test_output_value.txt; cat test_output_value.txt" "$expected_large_value" "line1\nline2\n"
+run_test "Large framed file value appended to a file" "rm -f test_output_value.txt; ./map --value-file test_large_value.txt --framed-output varint >> test_output_value.txt; ./map --framed-input varint -I {} -v '{}' < test_output_value.txt" "$expected_large_value" "line1\nline2\n"
+
 # Test with command value (--value-cmd flag and a simple echo command)
 run_test "Basic command value" "./map --discard-input --value-cmd -- echo -n 'cmd output'" "cmd output\ncmd output\n" "line1\nline2\n"
 
@@ -95,9 +103,43 @@ run_test "Basic command value with item pass through" "./map --value-cmd -- echo
 
 # Test with replacement string
 run_test "Basic command value with replacement string" "./map -I {} --value-cmd -- echo -n 'This is {}'" "This is line1\nThis is line2\nThis is line3\n" "line1\nline2\nline3"
+
+# Command values are spliced when writing to a pipe and buffered otherwise: both must give the same output
+run_test "Command value to a pipe" "./map -I {} --value-cmd -- seq {} | md5sum" "$(seq 100000 | md5sum)" "100000"
+run_test "Command value to a file" "./map -I {} --value-cmd -- seq {} > test_output_cmd.txt; md5sum < test_output_cmd.txt" "$(seq 100000 | md5sum)" "100000"
+
 run_test "Static value with replacement string" "./map -I {} -v 'Hello {}'" "Hello World\nHello People\n" "World\nPeople"
+run_test "Static value with prefix and suffix" "./map -I {} -v '[{}]' -c ', '" "[World], [People]" "\nWorld\n\nPeople\n"
+run_test "Static value without the replacement string" "./map -I {} -v 'Hello'" "Hello\nHello" "World\nPeople"
 run_test "Value file with replacement string" "./map -I '@REPLACE_ME@' --value-file test_file_replstr.txt" "What do you need?:\nLove\nis\nall\nyou\nneed\nWhat do I need?:\nLove\nis\nall\nyou\nneed\n" "What do you need?\nWhat do I need?"
 
+# Test reading the input from a file (memory mapped)
+run_test "Input file" "./map -I {} -v 'Hello {}' --input test_multiline.txt" "Hello multi-line\nHello test\nHello content" ""
+run_test "Regular file on stdin" "./map -I {} -v 'Hello {}' < test_multiline.txt" "Hello multi-line\nHello test\nHello content" ""
+
+# Test mapping several input files
+run_test "Several input files in order" "./map -I {} -v '<{}>' -c ',' --keep-order --input test_multiline.txt test_file.txt test_multiline.txt" "<multi-line>,<test>,<content>,<test content>,<multi-line>,<test>,<content>" ""
+run_test "Several input files" "./map -I {} -v '<{}>' --input test_multiline.txt --input test_file.txt | sort" "<content>\n<multi-line>\n<test content>\n<test>" ""
+run_error_test "Byte range overflowing with its suffix" "./map -v 'mapped' --range 0:17179869184G < test_multiline.txt" "invalid --range" ""
+run_error_test "Byte range with several input files" "./map -v 'mapped' --range 0:1 --input test_multiline.txt test_file.txt" "cannot be used with several input files" ""
+
+# Test mapping only the items starting within a byte range
+run_test "Byte range" "./map -I {} -v 'Hello {}' --range 5:12 --input test_multiline.txt" "Hello test" ""
+run_test "Byte range up to the end" "./map -I {} -v 'Hello {}' --range 11: < test_multiline.txt" "Hello test\nHello content" ""
+
+# Test that shards split the items without overlapping
+run_test "Hash shards" "for i in 0 1 2; do ./map -I {} -v '{}' --shard \$i/3 --input test_multiline.txt; echo; done | grep . | sort" "content\nmulti-line\ntest" ""
+
+# Test that tagged split runs merge back into a single run output
+run_test "Tagged output" "./map --tag seq -I {} -v '<{}>' -c ,; echo; printf 'ab\\ncd\\n' | ./map --tag offset -v x -c ," "0\t<a>,1\t<b>\n0\tx,3\tx" "a\nb\n"
+run_test "Merge tagged shards" "for i in 0 1 2; do seq 1 100 | ./map --tag seq --shard \$i/3 -I {} -v '<{}>' > test_split.\$i; done; ./map --merge test_split.0 test_split.1 test_split.2 | tr '\\n' ' '" "$(seq 1 100 | sed 's/.*/<&>/' | paste -sd' ')" ""
+run_test "Merge tagged ranges" "seq 1 100 > test_split.in; for r in 0:50 50:120 120:; do ./map --tag offset --range \$r -I {} -v '<{}>' --input test_split.in > test_split.\${r%%:*}; done; ./map --merge --input test_split.0 test_split.50 test_split.120 | tr '\\n' ' '" "$(seq 1 100 | sed 's/.*/<&>/' | paste -sd' ')" ""
+run_error_test "Merge untagged records" "printf 'a\\n' > test_split.in; ./map --merge test_split.in" "untagged record" ""
+
+# Test that split outputs cover every item once
+run_test "Split output by hash" "seq 1 100 | ./map -I {} -v '{}' --split-output 4:test_split; for i in 0 1 2 3; do cat test_split.\$i; echo; done | grep . | sort -n | tr '\\n' ' '" "$(seq 1 100 | tr '\n' ' ')" ""
+run_test "Split output round-robin" "./map -I {} -v '<{}>' -c , --split-output 2:test_split --split-by round-robin; cat test_split.0; echo; cat test_split.1" "<a>,<c>\n<b>" "a\nb\nc\n"
+
 # -----------------
 # Custom Separator/Concatenator Tests
 # -----------------
@@ -108,6 +150,12 @@ run_test "Custom separator" "./map --discard-input -v 'mapped' -s ','" "mapped,m
 # Test with custom separator and concatenator
 run_test "Custom separator and concatenator" "./map --discard-input -v 'mapped' -s ',' -c ';'" "mapped;mapped\n" "line1,line2\n"
 
+# Test with multi-byte separator and concatenator
+run_test "Multi-byte separator" "tr -d '\\n' | ./map -I {} -v '<{}>' -s '||' -c '\\t'" "<line1>\t<line|2>\t<line3>" "line1||line|2||line3"
+
+# Test with NUL-delimited input
+run_test "NUL-delimited input" "tr '\\n' '\\0' | ./map -0 -c ',' -I {} -v '<{}>'" "<line 1>,<line 2>" "line 1\nline 2"
+
 # -----------------
 # Edge Case Tests
 # -----------------
@@ -117,12 +165,53 @@ run_test "Empty input" "./map --discard-input -v 'mapped'" "" ""
 
 # Test with multiple separators in a row with no content
 run_test "Multiple separators" "./map --discard-input -v 'mapped'" "" "\n\n\n"
+run_test "Static value skipping empty items" "./map -v 'mapped' -c ','" "mapped,mapped,mapped" "\na\n\n\nb\n\nc"
 
 # Test with large input (simulation)
 large_input=$(printf 'line\n%.0s' {1..100})
 expected_large_output=$(printf 'mapped\n%.0s' {1..100})
 run_test "Large input" "./map --discard-input -v 'mapped'" "$expected_large_output" "$large_input"
 
+# Test with items spanning several input reads
+long_item=$(printf 'x%.0s' {1..10000})
+run_test "Items spanning input reads" "./map -I {} -v '<{}>'" "<a>\n<$long_item>\n<b>" "a\n$long_item\nb\n"
+run_test "Template with several slots" "./map -I {} -v '{}={}'" "a=a\n$long_item=$long_item\nb=b" "a\n$long_item\nb\n"
+
+# Test field placeholders
+run_test "Tab separated fields" "./map -I {} -v '{2}:{1}'" "b:a\nd:c" "a\tb\nc\td\n"
+run_test "Field delimiter" "./map -I {} -d , -v '{3} {1} [{4}] {0}'" "c a [] a,b,c\nz x [] x,y,z" "a,b,c\nx,y,z\n"
+run_test "Multi-byte field delimiter" "./map -I {} --field-delimiter '::' -v '{2}'" "b:c\ne" "a::b:c\nd::e\n"
+run_test "Fields of long items" "./map -I {} -d , -v '{2}'" "$long_item\nb" "a,$long_item\na,b\n"
+run_test "Fields in command arguments" "./map -I {} -d , --value-cmd -- echo -n '{2}' '{1}'" "b a\nd c" "a,b\nc,d\n"
+run_test "Braces without -I {}" "./map -I @ -v '{1}@'" "{1}a" "a\n"
+run_test "JSON values" "./map -I {} -v '{.user.id}={.user.name}'" "1=ann\n2=bob" '{"user": {"id": 1, "name": "ann"}}\n{"user": {"name": "bob", "id": 2}}\n'
+run_test "JSON arrays, objects and missing values" "./map -I {} -v '{.a[1]} {.b} [{.c}]'" '2 {"x": [3]} []' '{"a": [1, 2], "b": {"x": [3]}}\n'
+run_test "JSON escaped strings" "./map -I {} -v '{.s}'" 'say "hi"\n\xc3\xa9' '{"s": "say \\"hi\\""}\n{"s": "\\u00e9"}\n'
+run_test "JSON values in command arguments" "./map -I {} --value-cmd -- echo -n '{.name}'" "ann\nbob" '{"name": "ann"}\n{"name": "bob"}\n'
+run_test "Item transforms" "./map -I {} -v '{upper} {len} {basename} {dirname} {ext}'" "/TMP/A.TXT 10 a.txt /tmp txt\nREADME 6 README . " "/tmp/a.txt\nREADME\n"
+run_test "Chained transforms" "./map -I {} -d , -v '{1|trim|lower}={2|substr:0:3|urlencode}'" "ab=x%20y\ncd=%3D" " AB ,x yz\nCd,=\n"
+run_test "Hash transform" "./map -I {} -v '{xxhash}'" "d24ec4f1a98c6e5b" "a\n"
+run_test "JSON value transforms" "./map -I {} -v '{.path|basename|upper}'" "B.TXT" '{"path": "/a/b.txt"}\n'
+run_test "Transforms in command arguments" "./map -I {} --value-cmd -- echo -n '{upper}'" "AB\nCD" "ab\ncd\n"
+run_error_test "Empty field delimiter" "./map -I {} -d '' -v '{1}'" "must not be empty" "a\n"
+
+# Test the io_uring backend (falls back to regular I/O when unsupported)
+run_test "io_uring backend" "./map --io-uring -I {} -v '<{}>'" "<a>\n<$long_item>\n<b>" "a\n$long_item\nb\n"
+run_test "io_uring backend to file" "./map --io-uring --discard-input -v 'mapped' > test_output_uring.txt; cat test_output_uring.txt" "$expected_large_output" "$large_input"
+
+# Test the output flush policies
+run_test "Flush per record" "./map --flush record -I {} -v '<{}>'" "<a>\n<b>" "a\nb\n"
+run_test "Flush by time while the input is quiet" "(echo a; sleep 2) | timeout 1 ./map --flush time:50 -I {} -v '<{}>'" "<a>" ""
+run_test "Flush small blocks" "./map --flush block:3 -I {} -v '<{}>'" "<$long_item>\n<b>" "$long_item\nb\n"
+run_test "Framed output read back as framed input" "./map --framed-output varint -I {} -v '<{}>' | ./map --framed-input varint -I {} -v '{}'" "<a>\n<b>" "a\nb\n"
+run_test "Framed output length prefixes" "./map --framed-output u32be -I {} -v '{}' | od -An -tx1" " 00 00 00 01 61 00 00 00 02 62 63" "a\nbc\n"
+run_test "Framed constant values" "./map --framed-output varint -v x | od -An -tx1" " 01 78 01 78" "a\nb\n"
+run_test "Framed command values" "./map --framed-output varint --value-cmd -I {} echo {} | od -An -tx1" " 02 61 0a 02 62 0a" "a\nb\n"
+run_test "Framed input records holding separators" "printf '\\002a\\n\\001b' | ./map --framed-input varint -I {} -v '[{}]' -c ," "[a\n],[b]" ""
+run_error_test "Truncated framed input" "printf '\\005ab' | ./map --framed-input varint -v x" "truncated record" ""
+run_error_test "Invalid framing" "./map -v 'mapped' --framed u16" "invalid --framed" ""
+run_error_test "Invalid flush policy" "./map -v 'mapped' --flush sometimes" "invalid --flush" ""
+
 # -----------------
 # Error Tests
 # -----------------
@@ -134,14 +223,16 @@ run_error_test "Missing value argument" "./map" "One of -v, --value-file or --va
 run_error_test "Non-existent file" "./map --value-file nonexistent.txt" "Cannot open file" ""
 
 # Test with invalid separator argument
-run_error_test "Invalid separator" "./map -v 'mapped' -s 'ab'" "must be a single character" ""
+run_error_test "Invalid shard" "./map -v 'mapped' --shard 3/3" "invalid --shard" ""
+run_error_test "Invalid split output" "./map -v 'mapped' --split-output 0:test_split" "invalid --split-output" ""
+run_error_test "Invalid separator" "./map -v 'mapped' -s ''" "must not be empty" ""
 
 # -----------------
 # Test Results
 # -----------------
 
 # Clean up test files
-rm -f test_file.txt test_multiline.txt test_file_replstr.txt
+rm -f test_split.* test_file.txt test_multiline.txt test_file_replstr.txt test_output_uring.txt test_output_cmd.txt test_large_value.txt test_output_value.txt
 
 # Print test summary
 echo -e "\n===================="
@@ -27,6 +27,9 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* copy_file_range(2) and sendfile(2) are Linux specific */
+#define _GNU_SOURCE
+
 #include "files.h"
 
 #include <stdio.h>
@@ -37,6 +40,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 void* mmap_file(const char *filepath, size_t *content_length) {
     int fd = open(filepath, O_RDONLY);
@@ -72,6 +79,98 @@ void* mmap_file(const char *filepath, size_t *content_length) {
     return mapped;
 }
 
+void* mmap_fd(int fd, size_t *content_length) {
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        return NULL;
+    }
+
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+
+    /* the mapping is read front to back exactly once */
+    posix_madvise(mapped, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    *content_length = st.st_size;
+    return mapped;
+}
+
+size_t fcopy_range(int dst, int src, off_t offset, size_t len) {
+#ifdef __linux__
+    struct stat st;
+    int regular = fstat(dst, &st) == 0 && S_ISREG(st.st_mode);
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n;
+        if (regular) {
+            n = copy_file_range(src, &offset, dst, NULL, len - done, 0);
+        } else {
+            n = sendfile(dst, src, &offset, len - done);
+        }
+
+        if (n > 0) {
+            done += n;
+            continue;
+        }
+        if (n == 0) {
+            /* src is shorter than expected */
+            errno = EIO;
+            break;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN) {
+            struct pollfd pfd = { .fd = dst, .events = POLLOUT };
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        if (regular && done == 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EBADF)) {
+            /* e.g. different file systems on older kernels or an O_APPEND dst */
+            regular = 0;
+            continue;
+        }
+        break;
+    }
+    return done;
+#else
+    (void)dst;
+    (void)src;
+    (void)offset;
+    (void)len;
+    errno = ENOSYS;
+    return 0;
+#endif
+}
+
+int tmpfile_fd(void) {
+    const char *dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0') {
+        dir = "/tmp";
+    }
+
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/map.XXXXXX", dir) >= (int)sizeof(path)) {
+        fprintf(stderr, "Error: temporary directory path too long: %s\n", dir);
+        return -1;
+    }
+
+    /* close-on-exec from the start: commands are forked concurrently by the workers */
+    int fd = mkostemp(path, O_CLOEXEC);
+    if (fd == -1) {
+        fprintf(stderr, "Error: Cannot create temporary file in %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    /* nothing else needs to find it: it goes away as soon as fd is closed */
+    unlink(path);
+    return fd;
+}
+
 void assert_faccessible(const char *filepath) {
     if (open(filepath, O_RDONLY) == -1) {
         fprintf(stderr, "Error: Cannot open file %s: %s\n", filepath, strerror(errno));
@@ -31,6 +31,7 @@
 #define FILES_H
 
 #include <stdlib.h>
+#include <sys/types.h>
 
 /*
  * Maps the file identified by filepath to memory using mmap.
@@ -38,6 +39,31 @@
  */
 void* mmap_file(const char *filepath, size_t *content_length);
 
+/*
+ * Maps the regular file open on fd to memory using mmap.
+ * Sets content_length to the size of the file.
+ * Returns NULL, without reporting any error, if fd does not refer to
+ * a non-empty regular file or if it cannot be mapped:
+ * callers are expected to fall back to reading from fd.
+ */
+void* mmap_fd(int fd, size_t *content_length);
+
+/*
+ * Copies len bytes of src, starting at offset, to the current position of dst
+ * without going through user space (Linux only): copy_file_range(2) is used
+ * for regular files and sendfile(2) for anything else.
+ * Returns the number of bytes copied: less than len if an error occurred, with errno set.
+ * Nothing has been copied if the error is EINVAL or ENOSYS, meaning that dst
+ * or src do not support being copied to this way.
+ */
+size_t fcopy_range(int dst, int src, off_t offset, size_t len);
+
+/*
+ * Creates an anonymous temporary file in $TMPDIR (or /tmp), already unlinked,
+ * and returns a descriptor open for reading and writing, or -1 on failure.
+ */
+int tmpfile_fd(void);
+
 /*
  * Ensures file can be opened for read otherwise exits.
  */
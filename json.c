@@ -0,0 +1,396 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: json.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "json.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* room for this many offsets is made before every scan */
+#define JSON_INDEX_GROWTH (4 * SCAN_JSON_BLOCK)
+
+void json_index_init(json_index_t *idx) {
+    memset(idx, 0, sizeof(json_index_t));
+}
+
+void json_index_free(json_index_t *idx) {
+    free(idx->offsets);
+    json_index_init(idx);
+}
+
+void json_index_set(json_index_t *idx, const char *text, size_t len) {
+    idx->text = text;
+    idx->len = len;
+    idx->n = 0;
+    memset(&idx->state, 0, sizeof(scan_json_state_t));
+}
+
+/*
+ * Sets off to the offset of the k-th structural character of the text, indexing it further if needed.
+ * Returns 1 on success, 0 if the text has fewer structural characters and -1 if out of memory.
+ */
+static int json_at(json_index_t *idx, size_t k, size_t *off) {
+    while (k >= idx->n) {
+        if (idx->state.pos >= idx->len) {
+            return 0;
+        }
+
+        if (idx->cap - idx->n < JSON_INDEX_GROWTH) {
+            size_t cap = idx->cap * 2 + JSON_INDEX_GROWTH;
+            size_t *offsets = realloc(idx->offsets, cap * sizeof(size_t));
+            if (offsets == NULL) {
+                return -1;
+            }
+            idx->offsets = offsets;
+            idx->cap = cap;
+        }
+        idx->n += scan_json(idx->text, idx->len, &idx->state, idx->offsets + idx->n, idx->cap - idx->n);
+    }
+
+    *off = idx->offsets[k];
+    return 1;
+}
+
+static inline size_t json_skip_ws(const json_index_t *idx, size_t p) {
+    while (p < idx->len && (idx->text[p] == ' ' || idx->text[p] == '\t' || idx->text[p] == '\n' ||
+                            idx->text[p] == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+/*
+ * Moves *k past the structural characters of the value starting at p,
+ * the first of them being the k-th: none for numbers and literals.
+ * Returns 1 on success, 0 if the value is truncated and -1 if out of memory.
+ */
+static int json_skip_value(json_index_t *idx, size_t p, size_t *k) {
+    char c = idx->text[p];
+    size_t off;
+    int r;
+    if (c == '"') {
+        /* the opening and the closing quotes */
+        if ((r = json_at(idx, *k + 1, &off)) != 1) {
+            return r;
+        }
+        *k += 2;
+        return 1;
+    }
+    if (c != '{' && c != '[') {
+        return 1;
+    }
+
+    size_t depth = 0;
+    do {
+        if ((r = json_at(idx, (*k)++, &off)) != 1) {
+            return r;
+        }
+        c = idx->text[off];
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+    } while (depth > 0);
+    return 1;
+}
+
+/*
+ * Moves p and k from the object starting at p to its member named by the len bytes of key.
+ */
+static int json_step_key(json_index_t *idx, const char *key, size_t len, size_t *p, size_t *k) {
+    size_t open, close, colon;
+    int r;
+    if ((r = json_at(idx, (*k)++, &open)) != 1 || open != *p) {
+        return r == -1 ? -1 : 0;
+    }
+
+    for (;;) {
+        /* "key" : */
+        if ((r = json_at(idx, *k, &open)) != 1 || idx->text[open] != '"' ||
+            (r = json_at(idx, *k + 1, &close)) != 1 ||
+            (r = json_at(idx, *k + 2, &colon)) != 1 || idx->text[colon] != ':') {
+            return r == -1 ? -1 : 0;
+        }
+        *k += 3;
+        *p = json_skip_ws(idx, colon + 1);
+        if (*p >= idx->len) {
+            return 0;
+        }
+
+        if (close - open - 1 == len && memcmp(idx->text + open + 1, key, len) == 0) {
+            return 1;
+        }
+
+        size_t next;
+        if ((r = json_skip_value(idx, *p, k)) != 1 || (r = json_at(idx, (*k)++, &next)) != 1 ||
+            idx->text[next] != ',') {
+            return r == -1 ? -1 : 0;
+        }
+    }
+}
+
+/*
+ * Moves p and k from the array starting at p to its index-th element.
+ */
+static int json_step_index(json_index_t *idx, size_t index, size_t *p, size_t *k) {
+    size_t open, next;
+    int r;
+    if ((r = json_at(idx, (*k)++, &open)) != 1 || open != *p) {
+        return r == -1 ? -1 : 0;
+    }
+
+    *p = json_skip_ws(idx, open + 1);
+    if (*p >= idx->len || idx->text[*p] == ']') {
+        return 0;
+    }
+
+    for (size_t i = 0; i < index; i++) {
+        if ((r = json_skip_value(idx, *p, k)) != 1 || (r = json_at(idx, (*k)++, &next)) != 1 ||
+            idx->text[next] != ',') {
+            return r == -1 ? -1 : 0;
+        }
+        *p = json_skip_ws(idx, next + 1);
+        if (*p >= idx->len) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static inline int json_key_char(char c) {
+    return c != '.' && c != '[' && c != ']' && c != '{' && c != '}' && c != '|';
+}
+
+size_t json_path_parse(const char *path, size_t len) {
+    if (len == 0 || path[0] != '.') {
+        return 0;
+    }
+
+    size_t i = 0;
+    size_t steps = 0;
+    while (i < len) {
+        if (path[i] == '.' && i + 1 < len && path[i + 1] == '[') {
+            /* .[0] */
+            i++;
+        } else if (path[i] == '.') {
+            size_t start = ++i;
+            while (i < len && json_key_char(path[i])) {
+                i++;
+            }
+            if (i == start) {
+                return 0;
+            }
+            steps++;
+        } else if (path[i] == '[') {
+            size_t start = ++i;
+            while (i < len && path[i] >= '0' && path[i] <= '9') {
+                i++;
+            }
+            if (i == start || i == len || path[i] != ']') {
+                return 0;
+            }
+            i++;
+            steps++;
+        } else {
+            break;
+        }
+    }
+    return steps > 0 ? i : 0;
+}
+
+int json_get(json_index_t *idx, const char *path, size_t pathlen, json_value_t *value) {
+    size_t p = json_skip_ws(idx, 0);
+    size_t k = 0;
+    int r;
+    if (p >= idx->len) {
+        return 0;
+    }
+
+    size_t i = 0;
+    while (i < pathlen) {
+        if (path[i] == '.' && i + 1 < pathlen && path[i + 1] == '[') {
+            i++;
+            continue;
+        }
+
+        if (path[i] == '.') {
+            size_t start = ++i;
+            while (i < pathlen && json_key_char(path[i])) {
+                i++;
+            }
+            if (idx->text[p] != '{') {
+                return 0;
+            }
+            r = json_step_key(idx, path + start, i - start, &p, &k);
+        } else {
+            size_t index = 0;
+            for (i++; i < pathlen && path[i] != ']'; i++) {
+                index = index * 10 + (size_t)(path[i] - '0');
+            }
+            i++;
+            if (idx->text[p] != '[') {
+                return 0;
+            }
+            r = json_step_index(idx, index, &p, &k);
+        }
+        if (r != 1) {
+            return r;
+        }
+    }
+
+    size_t first = k;
+    size_t end;
+    if ((r = json_skip_value(idx, p, &k)) != 1) {
+        return r;
+    }
+
+    char c = idx->text[p];
+    if (c == '"') {
+        size_t open, close;
+        json_at(idx, first, &open);
+        json_at(idx, first + 1, &close);
+        *value = (json_value_t){ idx->text + open + 1, close - open - 1, 1 };
+        return 1;
+    }
+
+    if (c == '{' || c == '[') {
+        json_at(idx, k - 1, &end);
+        end++;
+    } else {
+        /* numbers and literals extend up to the next structural character */
+        if ((r = json_at(idx, k, &end)) == -1) {
+            return -1;
+        }
+        if (r == 0) {
+            end = idx->len;
+        }
+        while (end > p && (idx->text[end - 1] == ' ' || idx->text[end - 1] == '\t' ||
+                           idx->text[end - 1] == '\n' || idx->text[end - 1] == '\r')) {
+            end--;
+        }
+        if (end == p) {
+            return 0;
+        }
+    }
+
+    *value = (json_value_t){ idx->text + p, end - p, 0 };
+    return 1;
+}
+
+static int json_hex4(const char *s, unsigned *cp) {
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') {
+            v |= (unsigned)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            v |= (unsigned)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            v |= (unsigned)(c - 'A' + 10);
+        } else {
+            return 0;
+        }
+    }
+    *cp = v;
+    return 1;
+}
+
+static size_t json_utf8(unsigned cp, char *dst) {
+    if (cp < 0x80) {
+        dst[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        dst[0] = (char)(0xC0 | (cp >> 6));
+        dst[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        dst[0] = (char)(0xE0 | (cp >> 12));
+        dst[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        dst[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    dst[0] = (char)(0xF0 | (cp >> 18));
+    dst[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    dst[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    dst[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+size_t json_unescape(const char *src, size_t len, char *dst) {
+    char *p = dst;
+    size_t i = 0;
+    while (i < len) {
+        const char *bs = memchr(src + i, '\\', len - i);
+        size_t plain = bs != NULL ? (size_t)(bs - (src + i)) : len - i;
+        memmove(p, src + i, plain);
+        p += plain;
+        i += plain;
+        if (i + 1 >= len) {
+            /* no escape, or a trailing backslash kept as it is */
+            if (i < len) {
+                *p++ = src[i++];
+            }
+            break;
+        }
+
+        char c = src[i + 1];
+        unsigned cp, lo;
+        switch (c) {
+            case '"': case '\\': case '/': *p++ = c; i += 2; continue;
+            case 'b': *p++ = '\b'; i += 2; continue;
+            case 'f': *p++ = '\f'; i += 2; continue;
+            case 'n': *p++ = '\n'; i += 2; continue;
+            case 'r': *p++ = '\r'; i += 2; continue;
+            case 't': *p++ = '\t'; i += 2; continue;
+            case 'u':
+                if (i + 6 > len || !json_hex4(src + i + 2, &cp)) {
+                    break;
+                }
+                i += 6;
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 6 <= len && src[i] == '\\' && src[i + 1] == 'u' &&
+                    json_hex4(src + i + 2, &lo) && lo >= 0xDC00 && lo < 0xE000) {
+                    /* surrogate pair */
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 6;
+                }
+                p += json_utf8(cp, p);
+                continue;
+            default:
+                break;
+        }
+
+        /* not a valid escape: kept as it is */
+        *p++ = src[i++];
+    }
+    return p - dst;
+}
@@ -0,0 +1,91 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: json.h
+ * Description: lazy extraction of values from JSON items
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+#include "scan.h"
+
+/*
+ * Structural index of a JSON text, built lazily: only as far into the text
+ * as the values looked up so far required. Reused from text to text.
+ */
+typedef struct {
+    const char *text;
+    size_t len;
+
+    /* offsets of the structural characters found so far (see scan_json) */
+    size_t *offsets;
+    size_t n;
+    size_t cap;
+    scan_json_state_t state;
+} json_index_t;
+
+typedef struct {
+    const char *data;
+    size_t len;
+
+    /* set for strings: data is then their content, without quotes and still escaped */
+    int string;
+} json_value_t;
+
+void json_index_init(json_index_t *idx);
+void json_index_free(json_index_t *idx);
+
+/*
+ * Makes the len bytes of text the one indexed by idx from now on.
+ */
+void json_index_set(json_index_t *idx, const char *text, size_t len);
+
+/*
+ * Returns the length of the path at the beginning of the len bytes of path,
+ * made of object keys and array indices as in .user.id or .tags[0], or 0 if there is none.
+ * Keys extend up to the next . [ ] { } or |.
+ */
+size_t json_path_parse(const char *path, size_t len);
+
+/*
+ * Looks up the value at path, of pathlen bytes as validated by json_path_parse,
+ * in the text of idx. Numbers, literals, objects and arrays are returned as they appear.
+ * Returns 1 if found, 0 if there is no such value (or the text is not valid JSON)
+ * and -1 if out of memory.
+ */
+int json_get(json_index_t *idx, const char *path, size_t pathlen, json_value_t *value);
+
+/*
+ * Decodes the escape sequences of the len bytes of string content in src into dst,
+ * which must hold len bytes: the result is never longer. \u escapes are encoded as UTF-8.
+ * Returns the length of the result.
+ */
+size_t json_unescape(const char *src, size_t len, char *dst);
+
+#endif // JSON_H
@@ -29,53 +29,344 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "buffers.h"
+#include "files.h"
+#include "hash.h"
 #include "options.h"
 #include "map.h"
+#include "scan.h"
+#include "writer.h"
+#include "strings.h"
 
 #define FALLBACK_BUFFER_SIZE 4069
-#define BUFFER_INCREASE_FACTOR 2
+
+/* size of the pre-rendered block of values replicated by map_constant */
+#define CONSTANT_BLOCK_SIZE (64 * 1024)
+
+/* write buffer of each --split-output file, unless set with --flush block:<size> */
+#define SPLIT_BUFFER_SIZE (1024 * 1024)
+
+/* items are assigned to --split-output files with a hash unrelated to the --shard one */
+#define SPLIT_HASH_SEED 0x5eedULL
+
+/* smaller values are cheaper to copy into the output buffer than to have the kernel copy them */
+#define KCOPY_MIN_SIZE (32 * 1024)
 
 static inline int init_from_opts(map_config_t *config, int *argc, char ***argv) {
     map_config_init(config);
     map_config_load_from_args(config, argc, argv);
 
-    /* Handle value from file if specified */
-    if (config->vsource_t == MAP_VALUE_SOURCE_UNSPECIFIED) {
+    if (config->merge_f) {
+        if (config->vsource_t != MAP_VALUE_SOURCE_UNSPECIFIED || config->tag != MAP_TAG_NONE) {
+            fprintf(stderr, "Error: --merge cannot be used with a map value nor with --tag\n");
+            return -1;
+        }
+        if (config->ipaths_len == 0) {
+            fprintf(stderr, "Error: --merge requires the input files to merge\n");
+            return -1;
+        }
+    } else if (config->vsource_t == MAP_VALUE_SOURCE_UNSPECIFIED) {
+        /* Handle value from file if specified */
         /* Neither -v nor --value-file nor --value-cmd specified */
         fprintf(stderr, "Error: One of -v, --value-file or --value-cmd must be explicitly specified\n");
         print_usage(*argv);
         return -1;
     }
 
+    if (config->range_f && config->ipaths_len > 1) {
+        fprintf(stderr, "Error: --range cannot be used with several input files\n");
+        return -1;
+    }
+
+    if (config->split_count > 0 && config->ipaths_len > 1) {
+        fprintf(stderr, "Error: --split-output cannot be used with several input files\n");
+        return -1;
+    }
+
+    if (config->range_f && config->frame_in != BUFFER_FRAME_NONE) {
+        fprintf(stderr, "Error: --range cannot be used with framed input\n");
+        return -1;
+    }
+
+    if (config->frame_out != BUFFER_FRAME_NONE) {
+        if (config->concatenator != NULL) {
+            fprintf(stderr, "Error: -c cannot be used with framed output\n");
+            return -1;
+        }
+        /* records are delimited by their length prefix alone */
+        config->concatenator = "";
+        config->concatenator_len = 0;
+    }
+
     /* defaulting the concatenation argument to the separator one if unspecified */
-    if (config->concatenator == 0) {
+    if (config->concatenator == NULL) {
         config->concatenator = config->separator;
+        config->concatenator_len = config->separator_len;
     }
 
+    return map_config_compile(config);
+}
+
+/*
+ * Sets up reader over path (stdin if NULL): regular files are memory mapped
+ * and split in place, anything else is read through a sliding window.
+ */
+static inline int init_reader(const char *path, buffer_reader_t *reader, int *input) {
+    int src = STDIN_FILENO;
+    if (path != NULL) {
+        src = open(path, O_RDONLY | O_CLOEXEC);
+        if (src == -1) {
+            fprintf(stderr, "Error: Cannot open file %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+    *input = src;
+
+    size_t maplen = 0;
+    void *map = mmap_fd(src, &maplen);
+    if (map != NULL) {
+        /* stdin might have been partially consumed already */
+        off_t offset = lseek(src, 0, SEEK_CUR);
+        if (offset < 0) {
+            offset = 0;
+        } else if ((size_t)offset > maplen) {
+            offset = maplen;
+        }
+        buffer_reader_init_mapped(reader, map, maplen, offset);
+        return 0;
+    }
+
+    if (buffer_reader_init(reader, src, calc_iobufsize(BUF_STDIN, FALLBACK_BUFFER_SIZE)) != BUFFER_SUCCESS) {
+        return -1;
+    }
     return 0;
 }
 
-static inline int init_buffers(buffer_t *ibuffer, buffer_t *obuffer) {
-    if (buffer_init(ibuffer, calc_iobufsize(BUF_STDIN, FALLBACK_BUFFER_SIZE)) != BUFFER_SUCCESS) {
+/*
+ * Sets up out to write to dst according to the flush policy,
+ * through a buffer as large as the block size if one was given.
+ */
+static inline int init_writer(const map_config_t *config, writer_t *out, int dst, writer_flush_t policy) {
+    size_t size = config->flush_size;
+    if (size == 0) {
+        size = calc_iobufsize(BUF_STDOUT, FALLBACK_BUFFER_SIZE);
+    }
+    if (writer_init(out, dst, size, policy, config->flush_ms) != BUFFER_SUCCESS) {
+        return BUFFER_MEM_ERROR;
+    }
+    out->frame = config->frame_out;
+    return BUFFER_SUCCESS;
+}
+
+static inline int init_buffers(const map_config_t *config, const char *path, buffer_reader_t *reader,
+                               writer_t *out, int dst, writer_flush_t policy, int *input) {
+    if (init_reader(path, reader, input) != 0) {
         return -1;
     }
+    buffer_reader_set_frame(reader, config->frame_in);
 
-    if (buffer_init(obuffer, calc_iobufsize(BUF_STDIN, FALLBACK_BUFFER_SIZE)) != BUFFER_SUCCESS) {
+    if (init_writer(config, out, dst, policy) != BUFFER_SUCCESS) {
         return -1;
     } 
 
     return 0;
 }
 
-static inline int do_map(FILE *dst, map_config_t *config, map_value_t *value, buffer_t *buffer) {
+/*
+ * Moves the value straight from the command output to out.
+ * Returns 1 if it cannot be spliced and must go through the output buffer instead.
+ */
+static inline int splice_map(writer_t *out, map_config_t *config, map_value_t *value) {
+    /* whatever is buffered comes first */
+    if (writer_flush(out) != BUFFER_SUCCESS) {
+        return -1;
+    }
+
+    ssize_t n;
+    size_t moved = 0;
+    while ((n = map_vsplice(config, value, out->fd)) > 0) {
+        moved += n;
+    }
+
+    if (n == -1) {
+        if (moved == 0 && !map_verr(config, value)) {
+            /* not supported for this output: stop trying */
+            out->splice_f = 0;
+            return 1;
+        }
+        fprintf(stderr, "Unable to write map value\n");
+        return -1;
+    }
+
+    map_vreset(config, value);
+    return 0;
+}
+
+/*
+ * Has the kernel copy the value file to out.
+ * Returns 1 if it is not worth it or not possible, and the value must go through the output buffer instead.
+ */
+static inline int kcopy_map(writer_t *out, map_config_t *config, map_value_t *value) {
+    int fd;
+    off_t offset;
+    size_t len;
+    if (!map_vfile(config, value, &fd, &offset, &len) || len < KCOPY_MIN_SIZE) {
+        return 1;
+    }
+
+    /* whatever is buffered comes first */
+    if (writer_frame(out, len) != BUFFER_SUCCESS || writer_flush(out) != BUFFER_SUCCESS) {
+        return -1;
+    }
+
+    size_t copied = fcopy_range(out->fd, fd, offset, len);
+    if (copied < len) {
+        if (copied == 0 && (errno == EINVAL || errno == ENOSYS)) {
+            /* not supported for this output: stop trying */
+            out->kcopy_f = 0;
+            return 1;
+        }
+        fprintf(stderr, "Unable to write map value: %s\n", strerror(errno));
+        return -1;
+    }
+
+    map_vreset(config, value);
+    return 0;
+}
+
+/*
+ * Collects the whole value in the scratch buffer of out before writing it,
+ * as its length must precede it in the framed output.
+ */
+static inline int frame_map(writer_t *out, map_config_t *config, map_value_t *value) {
+    buffer_t *record = &out->record;
+    buffer_reset(record);
+
+    while (map_veof(config, value) <= 0) {
+        if (buffer_available(record) == 0) {
+            size_t size = record->size > 0 ? record->size * 2 : FALLBACK_BUFFER_SIZE;
+            if (buffer_extend(record, size) != BUFFER_SUCCESS) {
+                return -1;
+            }
+        }
+
+        record->pos += map_vread(record->data + record->pos, record->size - record->pos, config, value);
+
+        if (map_verr(config, value) > 0) {
+            fprintf(stderr, "Unable to write map value\n");
+            return -1;
+        }
+    }
+    map_vreset(config, value);
+
+    if (writer_frame(out, record->pos) != BUFFER_SUCCESS ||
+        writer_write(out, record->data, record->pos) != BUFFER_SUCCESS) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Renders the compiled template for the item of value straight into the output buffer.
+ */
+static inline int render_map(writer_t *out, const template_t *t, map_value_t *value) {
+    template_ctx_t *ctx = &value->tctx;
+    size_t len;
+    template_ctx_set(ctx, value->item, value->itemlen);
+    if (template_bind(t, ctx, &len) != 0) {
+        perror("map");
+        return -1;
+    }
+    if (writer_frame(out, len) != BUFFER_SUCCESS) {
+        return -1;
+    }
+
+    buffer_t *buffer = &out->buf;
+    if (len <= buffer_available(buffer)) {
+        buffer->pos += template_render(t, ctx, buffer->data + buffer->pos);
+        return 0;
+    }
+
+    /* does not fit what is left of the buffer: one segment at a time */
+    for (size_t i = 0; i < t->nsegs; i++) {
+        if (writer_write(out, ctx->views[i].data, ctx->views[i].len) != BUFFER_SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline int do_map(writer_t *out, map_config_t *config, map_value_t *value) {
+    if (config->vtemplate != NULL) {
+        return render_map(out, config->vtemplate, value);
+    }
+
+    buffer_t *buffer = &out->buf;
     map_vload(config, value);
 
+    /* unframed records need no length: the record prefix can go first whatever the path */
+    if (out->frame == BUFFER_FRAME_NONE && writer_frame(out, 0) != BUFFER_SUCCESS) {
+        return -1;
+    }
+
+    if (out->kcopy_f) {
+        int r = kcopy_map(out, config, value);
+        if (r <= 0) {
+            return r;
+        }
+    }
+
+    if (out->splice_f) {
+        int r = splice_map(out, config, value);
+        if (r <= 0) {
+            return r;
+        }
+    }
+
+    const char *data;
+    size_t len;
+    if (map_vmem(config, value, &data, &len)) {
+        if (writer_frame(out, len) != BUFFER_SUCCESS) {
+            return -1;
+        }
+
+        if (len <= buffer_available(buffer)) {
+            memcpy(buffer->data + buffer->pos, data, len);
+            buffer->pos += len;
+        } else {
+            /* gather what is buffered so far and the value itself in a single write */
+            struct iovec iov[2] = {
+                { buffer->data, buffer->pos },
+                { (void*)data, len }
+            };
+            if (buffer_writev(out->fd, iov, 2) != BUFFER_SUCCESS) {
+                return -1;
+            }
+            buffer_reset(buffer);
+        }
+        map_vreset(config, value);
+        return 0;
+    }
+
+    if (out->frame != BUFFER_FRAME_NONE) {
+        return frame_map(out, config, value);
+    }
+
     /* loop to write out the mapped value to the output buffer until done */
     while (map_veof(config, value) <= 0) {
-        buffer_flush(dst, buffer);
-        buffer_reset(buffer);
+        if (buffer_available(buffer) == 0) {
+            if (buffer_flush(out->fd, buffer) != BUFFER_SUCCESS) {
+                return -1;
+            }
+            buffer_reset(buffer);
+        }
 
         size_t mapped = map_vread(buffer->data + buffer->pos, buffer->size - buffer->pos, config, value);
         buffer->pos += mapped;
@@ -89,91 +380,856 @@ static inline int do_map(FILE *dst, map_config_t *config, map_value_t *value, bu
     return 0;
 }
 
-int main(int argc, char *argv[]) {
-    int exit_code = EXIT_SUCCESS;
+/*
+ * Returns non-zero if item belongs to the shard selected with --shard (or if there is none).
+ */
+static inline int in_shard(const map_config_t *config, const char *item, size_t len) {
+    return !config->shard_f || hash_xxh64(item, len, 0) % config->shard_count == config->shard_index;
+}
 
-    map_config_t map_config;
-    if (init_from_opts(&map_config, &argc, &argv) != 0) {
-        return EXIT_FAILURE;
+/*
+ * Returns the --tag of item, the seq-th item read by reader.
+ */
+static inline uint64_t item_tag(const map_config_t *config, const buffer_reader_t *reader,
+                                const char *item, uint64_t seq) {
+    if (config->tag == MAP_TAG_OFFSET) {
+        return reader->base + (item - reader->buf.data);
+    }
+    return seq;
+}
+
+/*
+ * Maps a single input item and writes the result to out,
+ * preceded by the concatenator if this is not the first item mapped
+ * and led by "<tag>\t" with --tag.
+ * Empty items and items belonging to other shards are ignored.
+ */
+static inline int map_item(writer_t *out, map_config_t *config, map_value_t *value,
+                           const char *item, size_t len, uint64_t tag, size_t *nitems) {
+    if (len == 0 || !in_shard(config, item, len)) {
+        return 0;
+    }
+
+    if ((*nitems)++ > 0) {
+        if (writer_write(out, config->concatenator, config->concatenator_len) != BUFFER_SUCCESS) {
+            return -1;
+        }
+    }
+
+    if (config->tag != MAP_TAG_NONE) {
+        out->prefix = out->prefixbuf;
+        out->prefix_len = snprintf(out->prefixbuf, sizeof(out->prefixbuf), "%" PRIu64 "\t", tag);
     }
 
-    size_t bytes_read = 0;
+    /* reference the current item in place (to be used if referenced in the output) */
+    map_viset(value, item, len);
+
+    if (do_map(out, config, value) != 0) {
+        return -1;
+    }
+    return writer_end_record(out);
+}
+
+/*
+ * -v without references to the item maps every item to the same bytes:
+ * only the number of items matters.
+ */
+static inline int is_constant_map(const map_config_t *config) {
+    if (config->vsource_t != MAP_VALUE_SOURCE_CMDLINE_ARG || config->separator_len != 1 ||
+        config->shard_f || config->range_f || config->frame_in != BUFFER_FRAME_NONE ||
+        config->tag != MAP_TAG_NONE) {
+        return 0;
+    }
+    return config->replstr == NULL || (config->vtemplate != NULL && config->vtemplate->nslots == 0);
+}
+
+/*
+ * Returns 1 if the -v template references the item exactly once, as in -I {} -v '<{}>',
+ * and sets prefix and suffix to what comes before and after it.
+ */
+static inline int is_affix_map(const map_config_t *config, const char **prefix, size_t *prefix_len,
+                               const char **suffix, size_t *suffix_len) {
+    const template_t *t = config->vtemplate;
+    if (config->vsource_t != MAP_VALUE_SOURCE_CMDLINE_ARG || t == NULL || t->nslots != 1 ||
+        config->tag != MAP_TAG_NONE) {
+        return 0;
+    }
+
+    /* literal segments are never empty: at most one on each side of the slot */
+    size_t slot = t->segs[0].kind == TEMPLATE_LITERAL ? 1 : 0;
+    if (t->segs[slot].kind != TEMPLATE_ITEM || t->segs[slot].nfns > 0) {
+        return 0;
+    }
+
+    *prefix = slot > 0 ? t->segs[0].data : "";
+    *prefix_len = slot > 0 ? t->segs[0].len : 0;
+    *suffix = slot + 1 < t->nsegs ? t->segs[slot + 1].data : "";
+    *suffix_len = slot + 1 < t->nsegs ? t->segs[slot + 1].len : 0;
+    return 1;
+}
+
+/*
+ * Writes count more values to out, joined by the concatenator,
+ * out of units: nunits copies of the concatenator followed by the value.
+ */
+static int write_constant(writer_t *out, const map_config_t *config, const char *units, size_t unitlen,
+                          size_t nunits, size_t count, size_t *nitems) {
+    if (count == 0) {
+        return 0;
+    }
+
+    if (*nitems == 0) {
+        /* the very first value is not preceded by the concatenator */
+        if (writer_write(out, units + config->concatenator_len, unitlen - config->concatenator_len) != BUFFER_SUCCESS) {
+            return -1;
+        }
+        count--;
+        (*nitems)++;
+    }
+    *nitems += count;
+
+    while (count > 0) {
+        if (count <= buffer_available(&out->buf) / unitlen) {
+            /* few enough to be buffered */
+            while (count > 0) {
+                size_t n = count < nunits ? count : nunits;
+                if (writer_write(out, units, n * unitlen) != BUFFER_SUCCESS) {
+                    return -1;
+                }
+                count -= n;
+            }
+            break;
+        }
+
+        if (writer_flush(out) != BUFFER_SUCCESS) {
+            return -1;
+        }
+
+        /* straight from the pre-rendered block, as many times as needed */
+        struct iovec iov[16];
+        int iovcnt = 0;
+        while (count > 0 && iovcnt < 16) {
+            size_t n = count < nunits ? count : nunits;
+            iov[iovcnt].iov_base = (void*)units;
+            iov[iovcnt].iov_len = n * unitlen;
+            iovcnt++;
+            count -= n;
+        }
+        if (buffer_writev(out->fd, iov, iovcnt) != BUFFER_SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Maps the input of reader to a constant value: items are only counted as the input
+ * arrives and the value is written out in large replicated blocks.
+ */
+static int map_constant(map_config_t *config, buffer_reader_t *reader, writer_t *out, size_t *nitems) {
+    /* framed outputs have no concatenator, but the value length prefixes every value instead */
+    char header[BUFFER_FRAME_MAX_HEADER];
+    size_t header_len = 0;
+    if (out->frame != BUFFER_FRAME_NONE) {
+        header_len = buffer_frame_header(out->frame, config->vstatic_len, header);
+    }
+
+    size_t unitlen = config->concatenator_len + header_len + config->vstatic_len;
+    size_t nunits = CONSTANT_BLOCK_SIZE / unitlen > 0 ? CONSTANT_BLOCK_SIZE / unitlen : 1;
+
+    char *units = malloc(nunits * unitlen);
+    if (units == NULL) {
+        perror("map");
+        return -1;
+    }
+    for (size_t i = 0; i < nunits; i++) {
+        char *unit = units + i * unitlen;
+        memcpy(unit, config->concatenator, config->concatenator_len);
+        memcpy(unit + config->concatenator_len, header, header_len);
+        memcpy(unit + config->concatenator_len + header_len, config->vstatic, config->vstatic_len);
+    }
+
+    int after_sep = 1;
+    const char *block;
+    ssize_t len;
+    while ((len = buffer_reader_next_block(reader, &block)) > 0) {
+        size_t count = scan_count_items(block, len, config->separator[0], &after_sep);
+        if (write_constant(out, config, units, unitlen, nunits, count, nitems) != 0 ||
+            writer_end_record(out) != BUFFER_SUCCESS) {
+            len = -1;
+            break;
+        }
+    }
+
+    free(units);
+    return len < 0 ? -1 : 0;
+}
+
+/*
+ * Maps the input of reader to prefix + item + suffix, copying the items
+ * straight from the input with no per item rendering nor allocation.
+ */
+static int map_affix(map_config_t *config, buffer_reader_t *reader, writer_t *out, size_t *nitems,
+                     const char *prefix, size_t prefix_len, const char *suffix, size_t suffix_len) {
+    /* the concatenator and the prefix always go together, but for the first item */
+    size_t lead_len = config->concatenator_len + prefix_len;
+    char *lead = malloc(lead_len);
+    if (lead == NULL) {
+        perror("map");
+        return -1;
+    }
+    memcpy(lead, config->concatenator, config->concatenator_len);
+    memcpy(lead + config->concatenator_len, prefix, prefix_len);
+
+    const char *item;
+    size_t len;
+    int r;
+    while ((r = buffer_reader_next(reader, config->separator, config->separator_len, &item, &len)) > 0) {
+        if (len == 0 || !in_shard(config, item, len)) {
+            continue;
+        }
+
+        const char *head = (*nitems)++ > 0 ? lead : lead + config->concatenator_len;
+        size_t head_len = head == lead ? lead_len : prefix_len;
+
+        /* framed outputs have no concatenator: the length prefix comes first */
+        if (writer_frame(out, prefix_len + len + suffix_len) != BUFFER_SUCCESS ||
+            writer_write(out, head, head_len) != BUFFER_SUCCESS ||
+            writer_write(out, item, len) != BUFFER_SUCCESS ||
+            writer_write(out, suffix, suffix_len) != BUFFER_SUCCESS ||
+            writer_end_record(out) != BUFFER_SUCCESS) {
+            r = -1;
+            break;
+        }
+    }
+
+    free(lead);
+    return r;
+}
+
+/*
+ * Output files of --split-output, each with its own writer.
+ */
+typedef struct {
+    writer_t *outs;
+    int *fds;
+
+    /* items written to each file, as each one joins its own items */
+    size_t *nitems;
+    size_t count;
+} split_t;
+
+static void close_split(split_t *split) {
+    for (size_t i = 0; i < split->count; i++) {
+        if (split->fds[i] >= 0) {
+            writer_free(&split->outs[i]);
+            close(split->fds[i]);
+        }
+    }
+    free(split->outs);
+    free(split->fds);
+    free(split->nitems);
+}
+
+static int open_split(const map_config_t *config, split_t *split) {
+    split->count = config->split_count;
+    split->outs = calloc(split->count, sizeof(writer_t));
+    split->fds = malloc(split->count * sizeof(int));
+    split->nitems = calloc(split->count, sizeof(size_t));
+    if (split->outs == NULL || split->fds == NULL || split->nitems == NULL) {
+        perror("map");
+        split->count = 0;
+        close_split(split);
+        return -1;
+    }
+
+    for (size_t i = 0; i < split->count; i++) {
+        split->fds[i] = -1;
+    }
+
+    size_t size = config->flush_size > 0 ? config->flush_size : SPLIT_BUFFER_SIZE;
+    size_t pathlen = strlen(config->split_prefix) + 24;
+    char *path = malloc(pathlen);
+    if (path == NULL) {
+        perror("map");
+        close_split(split);
+        return -1;
+    }
+
+    for (size_t i = 0; i < split->count; i++) {
+        snprintf(path, pathlen, "%s.%zu", config->split_prefix, i);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd == -1) {
+            fprintf(stderr, "Error: Cannot open file %s: %s\n", path, strerror(errno));
+            free(path);
+            close_split(split);
+            return -1;
+        }
+
+        if (writer_init(&split->outs[i], fd, size, config->flush_policy, config->flush_ms) != BUFFER_SUCCESS) {
+            close(fd);
+            free(path);
+            close_split(split);
+            return -1;
+        }
+        split->fds[i] = fd;
+        split->outs[i].frame = config->frame_out;
+        split->outs[i].kcopy_f = config->vsource_t == MAP_VALUE_SOURCE_FILE && config->replstr == NULL;
+    }
+
+    free(path);
+    return 0;
+}
+
+/*
+ * Writes out whatever the time bounded writers of the split are holding.
+ */
+static int split_idle(void *arg) {
+    split_t *split = arg;
+    for (size_t i = 0; i < split->count; i++) {
+        if (writer_idle(&split->outs[i]) != BUFFER_SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Maps the input of reader to the --split-output files, routing each item
+ * by its hash (or round-robin) in the same pass.
+ */
+static int map_split(map_config_t *config, buffer_reader_t *reader, map_value_t *value, size_t *nitems) {
+    split_t split;
+    if (open_split(config, &split) != 0) {
+        return -1;
+    }
+
+    if (split.outs[0].policy == WRITER_FLUSH_TIME) {
+        buffer_reader_set_idle(reader, split_idle, &split, (int)config->flush_ms);
+    }
+
+    const char *item;
+    size_t len;
+    uint64_t seq = 0;
+    int r;
+    while ((r = buffer_reader_next(reader, config->separator, config->separator_len, &item, &len)) > 0) {
+        uint64_t tag = item_tag(config, reader, item, seq++);
+        if (len == 0 || !in_shard(config, item, len)) {
+            continue;
+        }
+
+        size_t i = config->split_rr_f ? *nitems % split.count
+                                      : hash_xxh64(item, len, SPLIT_HASH_SEED) % split.count;
+        if (map_item(&split.outs[i], config, value, item, len, tag, &split.nitems[i]) != 0) {
+            r = -1;
+            break;
+        }
+        (*nitems)++;
+    }
+
+    for (size_t i = 0; i < split.count; i++) {
+        if (writer_flush(&split.outs[i]) != BUFFER_SUCCESS) {
+            r = -1;
+        }
+    }
+
+    buffer_reader_set_idle(reader, NULL, NULL, 0);
+    close_split(&split);
+    return r;
+}
+
+/*
+ * Maps every item of the input at path (stdin if NULL) to dst, flushing the output as per policy.
+ * Sets nitems to the number of items written.
+ */
+static int map_input(map_config_t *config, const char *path, int dst, writer_flush_t policy,
+                     int uring, size_t *nitems) {
+    int exit_code = 0;
 
     map_value_t map_value;
     map_value_init(&map_value);
 
-    buffer_t buf;
-    buffer_t obuf;
+    buffer_reader_t reader = {0};
+    writer_t out = {0};
+    int input = STDIN_FILENO;
 
-    if (init_buffers(&buf, &obuf) != 0) {
+    if (init_buffers(config, path, &reader, &out, dst, policy, &input) != 0) {
         fprintf(stderr, "Unable to initialize buffer. Aborting.\n");
-        exit_code = EXIT_FAILURE;
+        exit_code = -1;
         goto cleanup;
     }
 
+    if (config->range_f) {
+        if (buffer_reader_set_range(&reader, config->range_start, config->range_end,
+                                    config->separator_len) != 0) {
+            fprintf(stderr, "Error: --range requires a seekable input: %s\n", strerror(errno));
+            exit_code = -1;
+            goto cleanup;
+        }
+    }
+
+    if (uring) {
+        /* falls back to read(2)/write(2) silently if io_uring is not available */
+        buffer_uring_enable(reader.map != NULL ? -1 : input, dst);
+    }
+
     /*
-        read from stdin into the buffer
-        if the data read so far includes the separator character or this is the end of the input
-            map it to the map value and write it to the output buffer
-        else extend the buffer to read more and repeat
+        command outputs can go from pipe to pipe and value files can be copied by the kernel
+        without going through the output buffer: not with io_uring, as they could overtake
+        writes still in flight, and command outputs not when framed, as their length must come first
     */
+    struct stat st;
+    if (config->vsource_t == MAP_VALUE_SOURCE_CMD && !uring && out.frame == BUFFER_FRAME_NONE &&
+        fstat(dst, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        out.splice_f = 1;
+    }
+    if (config->vsource_t == MAP_VALUE_SOURCE_FILE && config->replstr == NULL && !uring) {
+        out.kcopy_f = 1;
+    }
 
-    while ((bytes_read = buffer_load(&buf, stdin)) > 0) {
-        int end_of_input = 0;
-        size_t i = 0;
-        int last_separator_pos = 0;
-
-        for (; i < bytes_read; i++) {
-            end_of_input = (i == bytes_read - 1) && feof(stdin);
-            if (buf.data[i] == map_config.separator || end_of_input == 1) {
-                size_t itemlen = i - last_separator_pos;
-                if (itemlen == 0) {
-                    /* ignore the current item if empty */
-                    last_separator_pos = i + 1;
-                    continue;
-                } else {
-                    /* save the current item (to be used if referenced in the output) */
-                    map_vicpy(&map_value, buf.data + last_separator_pos, itemlen);
-                    last_separator_pos = i + 1;
-                }
+    if (out.policy == WRITER_FLUSH_TIME) {
+        /* do not hold on to the output while the input is quiet */
+        buffer_reader_set_idle(&reader, writer_idle, &out, (int)config->flush_ms);
+    }
 
-                if (do_map(stdout, &map_config, &map_value, &obuf) != 0) {
-                    exit_code = EXIT_FAILURE;
-                    goto cleanup;
-                }
+    const char *item = NULL;
+    size_t itemlen = 0;
+    uint64_t seq = 0;
+    const char *prefix, *suffix;
+    size_t prefix_len, suffix_len;
+    int r = 0;
+
+    if (config->split_count > 0) {
+        r = map_split(config, &reader, &map_value, nitems);
+    } else if (is_constant_map(config)) {
+        r = map_constant(config, &reader, &out, nitems);
+    } else if (is_affix_map(config, &prefix, &prefix_len, &suffix, &suffix_len)) {
+        r = map_affix(config, &reader, &out, nitems, prefix, prefix_len, suffix, suffix_len);
+    } else {
+        /*
+            the reader keeps any unfinished item across reads from the input,
+            so that each item is mapped whole, one at a time
+        */
+        while ((r = buffer_reader_next(&reader, config->separator, config->separator_len, &item, &itemlen)) > 0) {
+            uint64_t tag = item_tag(config, &reader, item, seq++);
+            if (map_item(&out, config, &map_value, item, itemlen, tag, nitems) != 0) {
+                exit_code = -1;
+                goto cleanup;
+            }
+        }
+    }
+
+    if (r < 0) {
+        exit_code = -1;
+    }
+
+    /* Flush any remaining data in the output buffer */
+    if (writer_flush(&out) != BUFFER_SUCCESS) {
+        exit_code = -1;
+    }
+
+cleanup:
+    if (uring) {
+        buffer_uring_disable();
+    }
+    writer_free(&out);
+    buffer_reader_free(&reader);
+    if (input != STDIN_FILENO) {
+        close(input);
+    }
+    map_vclose(config, &map_value);
+
+    return exit_code;
+}
+
+/*
+ * Output of one of several input files, mapped by one of the workers.
+ */
+typedef struct {
+    const char *path;
+
+    /* where the output is written: either stdout or a spool file */
+    int out;
+    size_t nitems;
+
+    int err;
+    int done;
+    int written;
+} input_job_t;
+
+typedef struct {
+    map_config_t *config;
+    input_job_t *jobs;
+    size_t njobs;
+
+    /* index of the next job to be picked up by a worker */
+    size_t next;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_done;
+} input_pool_t;
+
+static void *input_worker(void *arg) {
+    input_pool_t *pool = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        size_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (i >= pool->njobs) {
+            break;
+        }
+
+        input_job_t *job = &pool->jobs[i];
+        /* spools are only read back once complete: no point in flushing them early */
+        writer_flush_t policy = job->out == STDOUT_FILENO ? pool->config->flush_policy : WRITER_FLUSH_BLOCK;
+        int err = map_input(pool->config, job->path, job->out, policy, 0, &job->nitems);
+
+        pthread_mutex_lock(&pool->lock);
+        job->err = err;
+        job->done = 1;
+        pthread_cond_signal(&pool->job_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+/*
+ * Copies the whole spool file to stdout through out.
+ */
+static int copy_spool(int spool, writer_t *out) {
+    buffer_t *obuf = &out->buf;
+    if (lseek(spool, 0, SEEK_SET) == -1) {
+        fprintf(stderr, "Error: unable to read back the output: %s\n", strerror(errno));
+        return -1;
+    }
+
+    ssize_t n;
+    while ((n = buffer_load(obuf, spool)) > 0) {
+        if (buffer_available(obuf) == 0 && writer_flush(out) != BUFFER_SUCCESS) {
+            return -1;
+        }
+    }
+    if (n == -1) {
+        fprintf(stderr, "Error: unable to read back the output: %s\n", strerror(errno));
+        return -1;
+    }
+    return writer_end_record(out);
+}
+
+/*
+ * Maps several input files concurrently.
+ * Each worker maps whole files into a spool of its own, which is then copied to stdout
+ * as soon as it is complete, so that items from different files never interleave.
+ * With --keep-order the first file is mapped straight to stdout and the other ones
+ * follow in the order they were given.
+ */
+static int map_inputs(map_config_t *config) {
+    size_t njobs = config->ipaths_len;
+    input_job_t *jobs = calloc(njobs, sizeof(input_job_t));
+    if (jobs == NULL) {
+        perror("map");
+        return -1;
+    }
 
-                if (end_of_input == 0) {
-                    buffer_flush(stdout, &obuf);
-                    buffer_reset(&obuf);
-                    obuf.data[obuf.pos++] = map_config.concatenator;
+    int exit_code = 0;
+    writer_t out = {0};
+    for (size_t i = 0; i < njobs; i++) {
+        jobs[i].path = config->ipaths[i];
+        jobs[i].out = (config->keep_order_f && i == 0) ? STDOUT_FILENO : tmpfile_fd();
+        if (jobs[i].out == -1) {
+            exit_code = -1;
+            goto cleanup;
+        }
+    }
+
+    if (init_writer(config, &out, STDOUT_FILENO, config->flush_policy) != BUFFER_SUCCESS) {
+        exit_code = -1;
+        goto cleanup;
+    }
+
+    /* the scan kernel is picked lazily: do it before there is any other thread around */
+    scan_kernel_name();
+
+    input_pool_t pool = { .config = config, .jobs = jobs, .njobs = njobs, .next = 0 };
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.job_done, NULL);
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t nworkers = ncpu > 0 ? (size_t)ncpu : 1;
+    if (nworkers > njobs) {
+        nworkers = njobs;
+    }
+
+    pthread_t *workers = calloc(nworkers, sizeof(pthread_t));
+    size_t started = 0;
+    while (workers != NULL && started < nworkers) {
+        if (pthread_create(&workers[started], NULL, input_worker, &pool) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        /* no threads: do all the work from here */
+        input_worker(&pool);
+    }
+
+    /* write out the outputs as they complete, joined by the concatenator */
+    size_t total = 0;
+    for (size_t nwritten = 0; nwritten < njobs; nwritten++) {
+        input_job_t *job = NULL;
+
+        pthread_mutex_lock(&pool.lock);
+        while (job == NULL) {
+            for (size_t i = config->keep_order_f ? nwritten : 0; i < njobs; i++) {
+                if (jobs[i].done && !jobs[i].written) {
+                    job = &jobs[i];
+                    break;
                 }
-            } else if (end_of_input) {
-                /* we have not found any separator character yet */
-                if (buffer_extend(&buf, buf.size * BUFFER_INCREASE_FACTOR) != BUFFER_SUCCESS) {
-                    fprintf(stderr, "Failed to allocate memory: unable to extend input buffer. Aborting.\n");
-                    exit_code = EXIT_FAILURE;
-                    goto cleanup;
+                if (config->keep_order_f) {
+                    break;
                 }
-
-                bytes_read += buffer_load(&buf, stdin);
             }
-
-            if (map_value.item != NULL) {
-                free(map_value.item);
-                map_value.item = NULL;
+            if (job == NULL) {
+                pthread_cond_wait(&pool.job_done, &pool.lock);
             }
         }
+        job->written = 1;
+        pthread_mutex_unlock(&pool.lock);
 
-        buffer_reset(&buf);
+        if (job->err != 0) {
+            exit_code = -1;
+        }
+        if (job->nitems == 0) {
+            continue;
+        }
+
+        if (job->out == STDOUT_FILENO) {
+            total += job->nitems;
+            continue;
+        }
+
+        if (total > 0 && writer_write(&out, config->concatenator, config->concatenator_len) != BUFFER_SUCCESS) {
+            exit_code = -1;
+            break;
+        }
+        if (copy_spool(job->out, &out) != 0) {
+            exit_code = -1;
+            break;
+        }
+        total += job->nitems;
+
+        /* release the spool space as early as possible */
+        close(job->out);
+        job->out = -1;
     }
 
-    /* Flush any remaining data in the output buffer */
-    buffer_flush(stdout, &obuf);
+    if (writer_flush(&out) != BUFFER_SUCCESS) {
+        exit_code = -1;
+    }
+
+    if (exit_code != 0) {
+        /* do not wait for the remaining files to be mapped for nothing */
+        pthread_mutex_lock(&pool.lock);
+        pool.next = njobs;
+        pthread_mutex_unlock(&pool.lock);
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    pthread_cond_destroy(&pool.job_done);
+    pthread_mutex_destroy(&pool.lock);
 
 cleanup:
-    buffer_free(&obuf);
-    buffer_free(&buf);
-    map_vclose(&map_config, &map_value);
+    writer_free(&out);
+    for (size_t i = 0; i < njobs; i++) {
+        if (jobs[i].out > STDOUT_FILENO) {
+            close(jobs[i].out);
+        }
+    }
+    free(jobs);
+    return exit_code;
+}
+
+/*
+ * One of the tagged streams being merged, with its current record.
+ */
+typedef struct {
+    const char *path;
+    buffer_reader_t reader;
+    int fd;
+
+    uint64_t tag;
+    const char *payload;
+    size_t len;
+} merge_stream_t;
 
+/*
+ * Moves stream to its next "<tag>\t<payload>" record.
+ * Returns 1 if there is one, 0 at the end of the stream or -1 on error.
+ */
+static int merge_next(const map_config_t *config, merge_stream_t *stream) {
+    const char *record;
+    size_t len;
+    int r;
+    do {
+        r = buffer_reader_next(&stream->reader, config->separator, config->separator_len, &record, &len);
+    } while (r > 0 && len == 0);
+    if (r <= 0) {
+        return r;
+    }
+
+    uint64_t tag = 0;
+    size_t i = 0;
+    while (i < len && record[i] >= '0' && record[i] <= '9' && tag <= (UINT64_MAX - 9) / 10) {
+        tag = tag * 10 + (uint64_t)(record[i++] - '0');
+    }
+    if (i == 0 || i == len || record[i] != '\t') {
+        fprintf(stderr, "Error: untagged record in %s\n", stream->path);
+        return -1;
+    }
+
+    stream->tag = tag;
+    stream->payload = record + i + 1;
+    stream->len = len - i - 1;
+    return 1;
+}
+
+static inline int merge_less(const merge_stream_t *streams, size_t a, size_t b) {
+    /* ties go to the stream given first, for a stable merge */
+    return streams[a].tag < streams[b].tag || (streams[a].tag == streams[b].tag && a < b);
+}
+
+static void merge_sift_down(const merge_stream_t *streams, size_t *heap, size_t n, size_t i) {
+    for (;;) {
+        size_t min = i;
+        size_t l = 2 * i + 1;
+        size_t r = l + 1;
+        if (l < n && merge_less(streams, heap[l], heap[min])) {
+            min = l;
+        }
+        if (r < n && merge_less(streams, heap[r], heap[min])) {
+            min = r;
+        }
+        if (min == i) {
+            return;
+        }
+        size_t tmp = heap[i];
+        heap[i] = heap[min];
+        heap[min] = tmp;
+        i = min;
+    }
+}
+
+/*
+ * Merges the records of the input files, each already ordered by --tag, into stdout in tag order,
+ * stripping the tags: split runs are put back together as a single run would have written them.
+ * Only the current record of each file is held, in the reader window.
+ */
+static int merge_inputs(map_config_t *config) {
+    size_t n = config->ipaths_len;
+    merge_stream_t *streams = calloc(n, sizeof(merge_stream_t));
+    size_t *heap = malloc(n * sizeof(size_t));
+    writer_t out = {0};
+    size_t opened = 0;
+    size_t nheap = 0;
+    size_t nitems = 0;
+    int exit_code = 0;
+
+    if (streams == NULL || heap == NULL) {
+        perror("map");
+        exit_code = -1;
+        goto cleanup;
+    }
+
+    if (init_writer(config, &out, STDOUT_FILENO, config->flush_policy) != BUFFER_SUCCESS) {
+        exit_code = -1;
+        goto cleanup;
+    }
+
+    for (; opened < n; opened++) {
+        merge_stream_t *stream = &streams[opened];
+        stream->path = config->ipaths[opened];
+        if (init_reader(stream->path, &stream->reader, &stream->fd) != 0) {
+            exit_code = -1;
+            goto cleanup;
+        }
+        buffer_reader_set_frame(&stream->reader, config->frame_in);
+
+        int r = merge_next(config, stream);
+        if (r < 0) {
+            opened++;
+            exit_code = -1;
+            goto cleanup;
+        }
+        if (r > 0) {
+            heap[nheap++] = opened;
+        }
+    }
+
+    for (size_t i = nheap / 2; i-- > 0;) {
+        merge_sift_down(streams, heap, nheap, i);
+    }
+
+    while (nheap > 0) {
+        merge_stream_t *stream = &streams[heap[0]];
+
+        if ((nitems++ > 0 && writer_write(&out, config->concatenator, config->concatenator_len) != BUFFER_SUCCESS) ||
+            writer_frame(&out, stream->len) != BUFFER_SUCCESS ||
+            writer_write(&out, stream->payload, stream->len) != BUFFER_SUCCESS ||
+            writer_end_record(&out) != BUFFER_SUCCESS) {
+            exit_code = -1;
+            goto cleanup;
+        }
+
+        int r = merge_next(config, stream);
+        if (r < 0) {
+            exit_code = -1;
+            goto cleanup;
+        }
+        if (r == 0) {
+            heap[0] = heap[--nheap];
+        }
+        merge_sift_down(streams, heap, nheap, 0);
+    }
+
+    if (writer_flush(&out) != BUFFER_SUCCESS) {
+        exit_code = -1;
+    }
+
+cleanup:
+    writer_free(&out);
+    for (size_t i = 0; i < opened; i++) {
+        buffer_reader_free(&streams[i].reader);
+        if (streams[i].fd != STDIN_FILENO) {
+            close(streams[i].fd);
+        }
+    }
+    free(streams);
+    free(heap);
     return exit_code;
 }
+
+int main(int argc, char *argv[]) {
+    map_config_t map_config;
+    if (init_from_opts(&map_config, &argc, &argv) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    int r;
+    if (map_config.merge_f) {
+        r = merge_inputs(&map_config);
+    } else if (map_config.ipaths_len > 1) {
+        r = map_inputs(&map_config);
+    } else {
+        size_t nitems = 0;
+        const char *path = map_config.ipaths_len == 1 ? map_config.ipaths[0] : NULL;
+        r = map_input(&map_config, path, STDOUT_FILENO, map_config.flush_policy,
+                      map_config.uring_f && map_config.split_count == 0, &nitems);
+    }
+
+    map_config_free(&map_config);
+
+    return r == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -36,17 +36,25 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/param.h>
 
-#define DEFAULT_SEPARATOR_VALUE '\n'
+#define DEFAULT_SEPARATOR_VALUE "\n"
+#define DEFAULT_FIELD_DELIMITER_VALUE "\t"
 
-char** _map_repl_argv(const char *replstr, const char *v, int argc, char *argv[]);
+/* with this replacement string, placeholders in braces such as {2} are recognized too */
+#define PLACEHOLDERS_REPLSTR "{}"
+
+static inline const char *_map_vitem_cstr(map_value_t *v);
 static inline void _map_vload_src_c(const map_config_t *config, map_value_t *v);
 static inline void _map_vload_src_f(const map_config_t *config, map_value_t *v);
 static inline void _map_vload_src_a(const map_config_t *config, map_value_t *v);
 
 void map_value_init(map_value_t *v) {
     memset(v, 0, sizeof(map_value_t));
+    v->vfd = -1;
+    template_ctx_init(&v->tctx);
 }
 
 void map_config_init(map_config_t *c) {
@@ -54,6 +62,104 @@ void map_config_init(map_config_t *c) {
 
     c->vsource_t = MAP_VALUE_SOURCE_UNSPECIFIED;
     c->separator = DEFAULT_SEPARATOR_VALUE;
+    c->separator_len = sizeof(DEFAULT_SEPARATOR_VALUE) - 1;
+    c->fdelim = DEFAULT_FIELD_DELIMITER_VALUE;
+    c->fdelim_len = sizeof(DEFAULT_FIELD_DELIMITER_VALUE) - 1;
+}
+
+void map_config_free(map_config_t *c) {
+    free(c->ipaths);
+    c->ipaths = NULL;
+    c->ipaths_len = 0;
+
+    if (c->vtemplate != NULL) {
+        template_free(c->vtemplate);
+        free(c->vtemplate);
+        c->vtemplate = NULL;
+    }
+
+    if (c->vfmap != NULL) {
+        munmap(c->vfmap, c->vfmap_len);
+        c->vfmap = NULL;
+        c->vfmap_len = 0;
+    }
+
+    if (c->cmd_templates != NULL) {
+        for (int i = 0; i < c->cmd_argc; i++) {
+            template_free(&c->cmd_templates[i]);
+        }
+        free(c->cmd_templates);
+        c->cmd_templates = NULL;
+    }
+}
+
+/*
+ * Compiles the command arguments referencing the item, so that each item
+ * only renders those. The command itself is never replaced.
+ */
+static int _map_compile_argv(map_config_t *c, const template_opts_t *opts) {
+    c->cmd_templates = calloc(c->cmd_argc > 0 ? c->cmd_argc : 1, sizeof(template_t));
+    if (c->cmd_templates == NULL) {
+        perror("map");
+        return -1;
+    }
+
+    for (int i = 1; i < c->cmd_argc; i++) {
+        const char *arg = c->cmd_argv[i];
+        if (template_compile(&c->cmd_templates[i], arg, strlen(arg), c->replstr, c->replstr_len, opts) != 0) {
+            perror("map");
+            return -1;
+        }
+        if (c->cmd_templates[i].nslots == 0) {
+            /* passed verbatim */
+            template_free(&c->cmd_templates[i]);
+        }
+    }
+    return 0;
+}
+
+int map_config_compile(map_config_t *c) {
+    if (c->replstr == NULL) {
+        return 0;
+    }
+
+    template_opts_t opts = {
+        .placeholders = c->replstr_len == sizeof(PLACEHOLDERS_REPLSTR) - 1 &&
+                        memcmp(c->replstr, PLACEHOLDERS_REPLSTR, c->replstr_len) == 0,
+        .delim = c->fdelim,
+        .delim_len = c->fdelim_len
+    };
+
+    const char *src;
+    size_t len;
+    switch (c->vsource_t) {
+        case MAP_VALUE_SOURCE_CMDLINE_ARG:
+            src = c->vstatic;
+            len = c->vstatic_len;
+            break;
+        case MAP_VALUE_SOURCE_CMD:
+            return _map_compile_argv(c, &opts);
+        case MAP_VALUE_SOURCE_FILE:
+            /* the file is mapped and scanned once: items only cost their own rendering */
+            c->vfmap = mmap_file(c->vfpath, &c->vfmap_len);
+            if (c->vfmap == NULL) {
+                return -1;
+            }
+            src = c->vfmap;
+            len = c->vfmap_len;
+            break;
+        default:
+            return 0;
+    }
+
+    c->vtemplate = malloc(sizeof(template_t));
+    if (c->vtemplate == NULL || template_compile(c->vtemplate, src, len, c->replstr, c->replstr_len, &opts) != 0) {
+        perror("map");
+        free(c->vtemplate);
+        c->vtemplate = NULL;
+        return -1;
+    }
+    return 0;
 }
 
 size_t map_vread(char *dst, size_t max, const map_config_t *config, map_value_t *v) {
@@ -61,10 +167,10 @@ size_t map_vread(char *dst, size_t max, const map_config_t *config, map_value_t
     switch (config->vsource_t) {
         case MAP_VALUE_SOURCE_CMD:
             /* relying on cmdsource's internal offset - no need to update ours */
-            return fread(dst, sizeof(char), max, v->cmdsource->s);
+            return readcmd(v->cmdsource, dst, max);
         case MAP_VALUE_SOURCE_CMDLINE_ARG:
         case MAP_VALUE_SOURCE_FILE:
-            len = MIN(strlen(v->msource + v->pos), max);
+            len = MIN(v->mlen - v->pos, max);
             memcpy(dst, v->msource + v->pos, len);
             v->pos += len;
             return len;
@@ -74,10 +180,51 @@ size_t map_vread(char *dst, size_t max, const map_config_t *config, map_value_t
     }
 }
 
+/* upper bound on the bytes moved by a single splice */
+#define MAP_SPLICE_CHUNK (1 << 20)
+
+ssize_t map_vsplice(const map_config_t *config, map_value_t *v, int fd) {
+    if (config->vsource_t != MAP_VALUE_SOURCE_CMD) {
+        errno = EINVAL;
+        return -1;
+    }
+    return splicecmd(v->cmdsource, fd, MAP_SPLICE_CHUNK);
+}
+
+int map_vmem(const map_config_t *config, const map_value_t *v, const char **data, size_t *len) {
+    switch (config->vsource_t) {
+        case MAP_VALUE_SOURCE_CMDLINE_ARG:
+        case MAP_VALUE_SOURCE_FILE:
+            *data = v->msource + v->pos;
+            *len = v->mlen - v->pos;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int map_vfile(const map_config_t *config, map_value_t *v, int *fd, off_t *offset, size_t *len) {
+    if (config->vsource_t != MAP_VALUE_SOURCE_FILE || config->replstr != NULL || v->msource == NULL) {
+        return 0;
+    }
+
+    if (v->vfd == -1) {
+        v->vfd = open(config->vfpath, O_RDONLY | O_CLOEXEC);
+        if (v->vfd == -1) {
+            return 0;
+        }
+    }
+
+    *fd = v->vfd;
+    *offset = v->pos;
+    *len = v->mlen - v->pos;
+    return 1;
+}
+
 int map_veof(const map_config_t *config, const map_value_t *v) {
     switch (config->vsource_t) {
         case MAP_VALUE_SOURCE_CMD:
-            return feof(v->cmdsource->s);
+            return v->cmdsource->eof;
         case MAP_VALUE_SOURCE_FILE:
         case MAP_VALUE_SOURCE_CMDLINE_ARG:
         default:
@@ -88,7 +235,7 @@ int map_veof(const map_config_t *config, const map_value_t *v) {
 int map_verr(const map_config_t *config, const map_value_t *v) {
     switch (config->vsource_t) {
         case MAP_VALUE_SOURCE_CMD:
-            return ferror(v->cmdsource->s);
+            return v->cmdsource->err;
         default:
             return 0;
     }
@@ -104,14 +251,6 @@ void map_vreset(const map_config_t *config, map_value_t *v) {
             break;
         case MAP_VALUE_SOURCE_CMDLINE_ARG:
         case MAP_VALUE_SOURCE_FILE:
-            if (v->msource != NULL) {
-                if (config->replstr) {
-                    free((void*)v->msource);
-                    v->msource = NULL;
-                }
-                v->pos = 0;
-            }
-            break;
         default:
             v->pos = 0;
             break;
@@ -127,67 +266,124 @@ void map_vclose(const map_config_t *config, map_value_t *v) {
             }
             break;
         case MAP_VALUE_SOURCE_CMDLINE_ARG:
-            if (v->msource != NULL) {
-                v->pos = 0;
-                if (config->replstr) {
-                    free((void*)v->msource);
-                }
-                v->msource = NULL;
-            }
+            v->pos = 0;
+            v->msource = NULL;
             break;
         case MAP_VALUE_SOURCE_FILE:
             v->pos = 0;
             if (v->msource != NULL) {
-                if (config->replstr) {
-                    free((void*)v->msource);
-                } else {
-                    munmap((void*)(v->msource), v->mlen);
-                }
+                munmap((void*)(v->msource), v->mlen);
                 v->msource = NULL;
                 v->mlen = 0;
             }
+            if (v->vfd != -1) {
+                close(v->vfd);
+                v->vfd = -1;
+            }
             break;
         default:
             break;
         /* no op for now */
     }
+
+    if (v->itemcpy != NULL) {
+        free(v->itemcpy);
+        v->itemcpy = NULL;
+        v->itemcap = 0;
+    }
+
+    free(v->argv);
+    free(v->args);
+    free(v->argoffs);
+    v->argv = NULL;
+    v->args = NULL;
+    v->argoffs = NULL;
+    v->argscap = 0;
+    template_ctx_free(&v->tctx);
+    v->item = NULL;
+    v->itemlen = 0;
+}
+
+/*
+ * Renders the compiled arguments referencing the item into the storage of v,
+ * next to the verbatim ones: nothing is allocated once the storage is large enough.
+ * Each argument is bound once and rendered right away, as binding the next one reuses the context.
+ */
+static void _map_vrender_argv(const map_config_t *config, map_value_t *v) {
+    template_ctx_set(&v->tctx, v->item, v->itemlen);
+
+    size_t used = 0;
+    for (int i = 1; i < config->cmd_argc; i++) {
+        const template_t *t = &config->cmd_templates[i];
+        size_t len;
+        if (t->nslots == 0) {
+            continue;
+        }
+        if (template_bind(t, &v->tctx, &len) != 0) {
+            perror("Unable to allocate memory for args");
+            exit(EXIT_FAILURE);
+        }
+
+        if (v->argscap - used < len + 1) {
+            size_t cap = v->argscap * 2 + len + 1;
+            char *args = realloc(v->args, cap);
+            if (args == NULL) {
+                perror("Unable to allocate memory for args");
+                exit(EXIT_FAILURE);
+            }
+            v->args = args;
+            v->argscap = cap;
+        }
+
+        v->argoffs[i] = used;
+        used += template_render(t, &v->tctx, v->args + used);
+        v->args[used++] = '\0';
+    }
+
+    /* the storage no longer moves: point the arguments to it */
+    for (int i = 1; i < config->cmd_argc; i++) {
+        if (config->cmd_templates[i].nslots > 0) {
+            v->argv[i] = v->args + v->argoffs[i];
+        }
+    }
 }
 
 void _map_vload_src_c(const map_config_t *config, map_value_t *v) {
     char **p_argv = config->cmd_argv;
     int argc = config->cmd_argc;
-    if (config->replstr) {
-        p_argv = _map_repl_argv(config->replstr, v->item, config->cmd_argc, config->cmd_argv);
-    } else if (config->stripi_f == 0) {
+    /* with a replstr, the item only reaches the command through the compiled arguments */
+    int compiled = config->cmd_templates != NULL;
+    int append = config->replstr == NULL && config->stripi_f == 0;
+
+    if (compiled || append) {
+        /* one more slot for the item, if appended, and the terminating NULL */
+        if (v->argv == NULL) {
+            v->argv = calloc(argc + 2, sizeof(char*));
+            v->argoffs = calloc(argc + 2, sizeof(size_t));
+            if (v->argv == NULL || v->argoffs == NULL) {
+                perror("Unable to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            memcpy(v->argv, config->cmd_argv, argc * sizeof(char*));
+        }
+        p_argv = v->argv;
+    }
+
+    if (compiled) {
+        _map_vrender_argv(config, v);
+    } else if (append) {
         /*
             If we are not stripping the input item,
             then we will be passing the input item as an additional
-            command argument: therefore, we need to extend the current argv
-            vector to hold one more arg.
+            command argument.
         */
-
-        p_argv = calloc((config->cmd_argc) + 2, sizeof(char*));
-        if (p_argv == NULL) {
-            perror("Unable to allocate memory");
-            exit(EXIT_FAILURE);
-        }
-        memcpy(p_argv, config->cmd_argv, config->cmd_argc * sizeof(char*));
-        p_argv[argc++] = v->item;
+        p_argv[argc++] = (char*)_map_vitem_cstr(v);
     }
 
     v->cmdsource = runcmd(argc, p_argv);
     if (v->cmdsource == NULL) {
         exit(EXIT_FAILURE);
     }
-
-    if (config->replstr) {
-        for (int i = 0; i < argc; i++) {
-            free(p_argv[i]);
-        }
-        free(p_argv);
-    } else if (config->stripi_f == 0) {
-        free(p_argv);
-    }
 }
 
 void _map_vload_src_f(const map_config_t *config, map_value_t *v) {
@@ -195,22 +391,11 @@ void _map_vload_src_f(const map_config_t *config, map_value_t *v) {
     if (v->msource == NULL) {
         exit(EXIT_FAILURE);
     }
-
-    if (config->replstr) {
-        const char *mmapped = v->msource;
-        v->msource = strreplall(v->msource, v->mlen, config->replstr, v->item);
-        munmap((void*)mmapped, v->mlen);
-        v->mlen = strlen(v->msource);
-    }
 }
 
 void _map_vload_src_a(const map_config_t *config, map_value_t *v) {
-    if (config->replstr) {
-        v->msource = strreplall(config->vstatic, strlen(config->vstatic), config->replstr, v->item);
-    } else {
-        v->msource = config->vstatic;
-    }
-    v->mlen = strlen(v->msource);
+    v->msource = config->vstatic;
+    v->mlen = config->vstatic_len;
 }
 
 void map_vload(const map_config_t *config, map_value_t *v) {
@@ -236,38 +421,35 @@ void map_vload(const map_config_t *config, map_value_t *v) {
     }
 }
 
-char** _map_repl_argv(const char *replstr, const char *v, int argc, char *argv[]) {
-    char **dst = calloc(argc + 1 /* execvp expects null-terminated array */, sizeof(char*));
-    if (!dst) {
-        perror("Unable to allocate memory");
-        exit(EXIT_FAILURE);
-    }
-    memcpy(dst, argv, argc * sizeof(char *));
+void map_viset(map_value_t *v, const char *src, size_t len) {
+    v->item = src;
+    v->itemlen = len;
+}
 
-    for (int i = 0; i < argc; i++) {
-        size_t len = strlen(argv[i]);
-        char *arg = calloc(len + 1, sizeof(char));
-        if (arg == NULL) {
-            perror("Unable to allocate memory for arg");
+void map_vicpy(map_value_t *v, const char *src, size_t len) {
+    if (v->itemcap < len + 1) {
+        char *item = realloc(v->itemcpy, len + 1);
+        if (item == NULL) {
+            fprintf(stderr, "Error: unable to allocate memory (%zu bytes): %s. Aborting\n", len, strerror(errno));
             exit(EXIT_FAILURE);
         }
-        memcpy(arg, argv[i], len);
-        if (i > 0) { /* do not replace the command */
-            arg = (char*)strreplall(arg, strlen(arg), replstr, v);
-        }
-        dst[i] = arg;
+        v->itemcpy = item;
+        v->itemcap = len + 1;
     }
+    memmove(v->itemcpy, src, len * sizeof(char));
+    v->itemcpy[len] = '\0';
 
-    return dst;
+    v->item = v->itemcpy;
+    v->itemlen = len;
 }
 
-void map_vicpy(map_value_t *v, const char *src, size_t len) {
-    char *item = calloc(len + 1, sizeof(char));
-    if (item == NULL) {
-        fprintf(stderr, "Error: unable to allocate memory (%zu bytes): %s. Aborting\n", len, strerror(errno));
-        exit(EXIT_FAILURE);
+/*
+ * Returns the current item as a 0-terminated string,
+ * copying it into the value own storage only if needed.
+ */
+const char *_map_vitem_cstr(map_value_t *v) {
+    if (v->item != v->itemcpy) {
+        map_vicpy(v, v->item, v->itemlen);
     }
-    memcpy(item, src, len * sizeof(char));
-
-    v->item = item;
+    return v->item;
 }
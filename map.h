@@ -31,6 +31,8 @@
 #define MAP_H
 
 #include "cmd.h"
+#include "writer.h"
+#include "template.h"
 #include <stdio.h>
 
 typedef struct map_value {
@@ -48,8 +50,29 @@ typedef struct map_value {
     /* tracks the last byte from msource written to the destination */
     size_t pos;
 
-    /* the input item to map: needed when the map value references the input item */
-    char *item;
+    /* the input item to map: needed when the map value references the input item.
+       This is a view into the input and it is not necessarily 0-terminated */
+    const char *item;
+    size_t itemlen;
+
+    /* storage owned by the value, reused whenever the item needs to be copied */
+    char *itemcpy;
+    size_t itemcap;
+
+    /*
+     * command line of --value-cmd, reused across items, and storage of the arguments rendered for the item
+     * along with their offsets in there, one per argument of the command line
+     */
+    char **argv;
+    char *args;
+    size_t argscap;
+    size_t *argoffs;
+
+    /* what compiled templates are rendered from for the current item */
+    template_ctx_t tctx;
+
+    /* the value file, kept open once needed for the kernel to copy from (see map_vfile) */
+    int vfd;
 } map_value_t;
 
 enum map_vsource {
@@ -59,44 +82,156 @@ enum map_vsource {
     MAP_VALUE_SOURCE_CMD
 };
 
+/* what leads each output record with --tag */
+typedef enum {
+    MAP_TAG_NONE = 0,
+    MAP_TAG_SEQ,        /* index of the item in the input */
+    MAP_TAG_OFFSET      /* byte offset of the item in the input */
+} map_tag_t;
+
 typedef struct map_config {
     union {
         const char *vstatic;
         const char *vfpath;
     };
 
-    char separator;
-    char concatenator;
+    /* length of vstatic */
+    size_t vstatic_len;
+
+    /* byte strings, not necessarily 0-terminated as they may contain NULs */
+    const char *separator;
+    size_t separator_len;
+    const char *concatenator;
+    size_t concatenator_len;
 
     enum map_vsource vsource_t;
 
     int cmd_argc;
     char **cmd_argv;
 
+    /* one per cmd_argv argument, with slots only for those referencing the item (see map_config_compile) */
+    template_t *cmd_templates;
+
     /* strip input flag */
     int stripi_f;
 
     const char *replstr;
+    size_t replstr_len;
+
+    /* separator of the item fields referenced by {N} placeholders */
+    const char *fdelim;
+    size_t fdelim_len;
+
+    /* the map value compiled once for all items, if it references them (see map_config_compile) */
+    template_t *vtemplate;
+
+    /* the value file, mapped once for vtemplate to point into */
+    void *vfmap;
+    size_t vfmap_len;
+
+    /* input file paths: stdin is read when there are none */
+    const char **ipaths;
+    size_t ipaths_len;
+
+    /* when the output is written out, see writer_flush_t */
+    writer_flush_t flush_policy;
+    size_t flush_size;
+    long flush_ms;
+
+    /* with several input files, write their outputs in the order they were given */
+    int keep_order_f;
+
+    /* use the io_uring I/O backend when available */
+    int uring_f;
+
+    /* only map the items starting in [range_start, range_end) of the input */
+    int range_f;
+    size_t range_start;
+    size_t range_end;
+
+    /* only map the items whose hash modulo shard_count is shard_index */
+    int shard_f;
+    size_t shard_index;
+    size_t shard_count;
+
+    /* lead each output record with the sequence number or input offset of its item */
+    map_tag_t tag;
+
+    /* k-way merge the tagged records of the input files by tag, instead of mapping */
+    int merge_f;
+
+    /* write the output to split_count files named <split_prefix>.<i>, by item hash or round-robin */
+    size_t split_count;
+    const char *split_prefix;
+    int split_rr_f;
+
+    /* length prefixed records rather than separated items, in the input and in the output */
+    buffer_frame_t frame_in;
+    buffer_frame_t frame_out;
 } map_config_t;
 
 void map_value_init(map_value_t *v);
 void map_config_init(map_config_t *c);
+void map_config_free(map_config_t *c);
+
+/*
+ * Compiles what can be prepared once for all items, once the options are set:
+ * a -v value or a value file referencing the item with -I becomes c->vtemplate,
+ * and the --value-cmd arguments referencing it become c->cmd_templates.
+ * Returns 0 on success, -1 on error.
+ */
+int map_config_compile(map_config_t *c);
+
+/*
+ * Sets the item referenced by v to the len bytes at src, without copying them.
+ * src must stay valid until the item has been mapped.
+ */
+void map_viset(map_value_t *v, const char *src, size_t len);
 
 /*
  * Copies len bytes of the given src into v to be later used for mapping operations.
  * The copied sequence of bytes will be null-terminated.
+ * The storage is owned by v and reused across calls.
  */
 void map_vicpy(map_value_t *v, const char *src, size_t len);
 
 /*
     Copies at most max_len bytes of src into dst.
-    Any occurrences of config->replstr will be replaced with src->item
-    if both are present.
+    The value is read verbatim: occurrences of config->replstr are
+    rendered from the compiled template instead (see map_config_compile).
 
     note: src must have been initialized using map_vload.
  */
 size_t map_vread(char* dst, size_t max, const map_config_t* config, map_value_t* v);
 
+/*
+ * Moves the next chunk of v straight to fd (a pipe) when v is the output of a command.
+ * Returns the number of bytes moved, 0 once v has been consumed fully,
+ * or -1 if v cannot be spliced: unless map_verr reports an error,
+ * v can still be consumed through map_vread.
+ *
+ * note: v must have been initialized using map_vload.
+ */
+ssize_t map_vsplice(const map_config_t *config, map_value_t *v, int fd);
+
+/*
+ * Sets data and len to the part of v not read yet when v is held in memory
+ * (MAP_VALUE_SOURCE_CMDLINE_ARG and MAP_VALUE_SOURCE_FILE) and returns 1.
+ * Returns 0 if v can only be consumed through map_vread.
+ *
+ * note: v must have been initialized using map_vload.
+ */
+int map_vmem(const map_config_t *config, const map_value_t *v, const char **data, size_t *len);
+
+/*
+ * Sets fd, offset and len to the part of v not read yet when v is the verbatim
+ * content of the value file (no replacement string), so that it can be copied
+ * by the kernel, and returns 1. Returns 0 in all other cases.
+ *
+ * note: v must have been initialized using map_vload.
+ */
+int map_vfile(const map_config_t *config, map_value_t *v, int *fd, off_t *offset, size_t *len);
+
 /*
  * Returns 1 if the source v has been consumed fully.
  */
@@ -129,6 +264,8 @@ void map_vreset(const map_config_t *config, map_value_t *v);
 /*
  * Loads the value source as per the type specified in config.
  * Exits the program upon failure or validation issue.
+ * A -v value or value file referencing the item is not loaded this way
+ * but rendered from config->vtemplate (see map_config_compile).
  */
 void map_vload(const map_config_t *config, map_value_t *v);
 
@@ -34,6 +34,9 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
 
 void print_usage(char *argv[]) {
     fprintf(stderr, "Usage: %s [options] <value-source-modifier> [--] [cmd]\n\n", argv[0]);
@@ -43,22 +46,246 @@ void print_usage(char *argv[]) {
     fprintf(stderr, "     --value-cmd                Use output from command as map value\n");
     fprintf(stderr, "                                Each mapped item will be appended to the command arguments list, unless -z is specified\n");
     fprintf(stderr, "\nOptional arguments:\n");
-    fprintf(stderr, "     -s <separator>             Separator character (default: '\\n')\n");
-    fprintf(stderr, "     -c <concatenator>          Concatenator character (default: same as separator)\n");
+    fprintf(stderr, "     -s <separator>             Separator string (default: '\\n')\n");
+    fprintf(stderr, "     -c <concatenator>          Concatenator string (default: same as separator)\n");
+    fprintf(stderr, "                                Both accept the escapes \\n, \\r, \\t, \\0, \\\\ and \\xHH\n");
+    fprintf(stderr, "     -0, --null                 Input items are separated by NUL bytes (same as -s '\\0')\n");
     fprintf(stderr, "     -z, --discard-input        Exclude input value from map output\n");
     fprintf(stderr, "     -I <replstr>               Specifies a replacement pattern string. When used, it overrides -z.\n");
-    fprintf(stderr, "                                When the pattern is found in the map value, it is replaced with the current item from the input.\n\n");
+    fprintf(stderr, "                                When the pattern is found in the map value, it is replaced with the current item from the input.\n");
+    fprintf(stderr, "                                With -I {}, {N} is replaced with the N-th field of the item ({0} being the whole item)\n");
+    fprintf(stderr, "                                and {.path} with the value at path in the item parsed as JSON, e.g. {.user.id} or {.tags[0]}.\n");
+    fprintf(stderr, "                                Values go through the transforms following them, e.g. {1|trim|upper} or {basename} for the item:\n");
+    fprintf(stderr, "                                upper, lower, trim, basename, dirname, ext, len, substr:<from>[:<to>], xxhash, urlencode.\n");
+    fprintf(stderr, "     -d, --field-delimiter <d>  Field delimiter for {N} placeholders (default: '\\t'), accepts the same escapes as -s\n");
+    fprintf(stderr, "     --input <file-path>...     Read input items from the given files instead of stdin.\n");
+    fprintf(stderr, "                                Several files are mapped concurrently, each output is written out whole.\n");
+    fprintf(stderr, "                                Arguments following --input are input files too, unless using --value-cmd.\n");
+    fprintf(stderr, "     --keep-order               Write the outputs of several input files in the order the files were given\n");
+    fprintf(stderr, "     --range <start>:<end>      Only map the items starting within the given byte range of a seekable input.\n");
+    fprintf(stderr, "                                Offsets accept K, M and G suffixes, end can be omitted to read up to the end.\n");
+    fprintf(stderr, "     --shard <i>/<N>            Only map the items assigned to shard i (0 <= i < N) by hashing their content\n");
+    fprintf(stderr, "     --flush <policy>           When to write out mapped items: block[:<size>] (default unless on a terminal),\n");
+    fprintf(stderr, "                                record (default on terminals) or time:<ms> (at most ms after being mapped)\n");
+    fprintf(stderr, "     --tag <tag>                Lead each output record with the seq number or the byte offset of its item\n");
+    fprintf(stderr, "                                in the input, followed by a tab\n");
+    fprintf(stderr, "     --merge <file>...          Merge files of tagged records, each in tag order, into tag order stripping the tags\n");
+    fprintf(stderr, "     --split-output <N>:<path>  Write the output to N files named <path>.0 to <path>.<N-1> instead of stdout\n");
+    fprintf(stderr, "     --split-by <policy>        How items are assigned to the --split-output files: hash (default) or round-robin\n");
+    fprintf(stderr, "     --framed <format>          Read and write length prefixed records instead of separated items:\n");
+    fprintf(stderr, "                                each record is its length as varint, u32le or u32be followed by its bytes\n");
+    fprintf(stderr, "     --framed-input <format>    Read length prefixed records, ignoring -s\n");
+    fprintf(stderr, "     --framed-output <format>   Write length prefixed records, with no concatenator\n");
+    fprintf(stderr, "     --io-uring                 Overlap reads and writes with mapping using io_uring, when supported\n\n");
     fprintf(stderr, "     -h, --help                 Show this help message\n");
 }
 
-void _parse_single_char_arg(char *arg, char *concat_arg, char opt_id, char *argv[]) {
-    if (strlen(arg) > 1) {
-        fprintf(stderr, "Error: the -%c argument must be a single character\n", opt_id);
+static int _hexval(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/*
+ * Decodes the escape sequences in arg in place (the result is never longer than arg)
+ * and points bytes to the result. The result may contain NULs, hence len.
+ */
+void _parse_bytes_arg(char *arg, const char **bytes, size_t *len, char opt_id, char *argv[]) {
+    char *dst = arg;
+    for (const char *src = arg; *src != '\0'; src++) {
+        if (*src != '\\' || src[1] == '\0') {
+            *dst++ = *src;
+            continue;
+        }
+
+        switch (*++src) {
+            case 'n': *dst++ = '\n'; break;
+            case 'r': *dst++ = '\r'; break;
+            case 't': *dst++ = '\t'; break;
+            case '0': *dst++ = '\0'; break;
+            case '\\': *dst++ = '\\'; break;
+            case 'x':
+                if (_hexval(src[1]) >= 0 && _hexval(src[2]) >= 0) {
+                    *dst++ = (char)(_hexval(src[1]) * 16 + _hexval(src[2]));
+                    src += 2;
+                    break;
+                }
+                /* fallthrough */
+            default:
+                /* not an escape sequence we know of: keep it as it is */
+                *dst++ = '\\';
+                *dst++ = *src;
+                break;
+        }
+    }
+
+    if (dst == arg) {
+        fprintf(stderr, "Error: the -%c argument must not be empty\n", opt_id);
         print_usage(argv);
         exit(EXIT_FAILURE);
     }
 
-    *concat_arg = arg[0];
+    *bytes = arg;
+    *len = dst - arg;
+}
+
+/*
+ * Parses a byte offset with an optional K, M or G (binary) suffix.
+ * Returns the position right after it, or NULL if arg does not start with a valid offset.
+ */
+static const char *_parse_offset(const char *arg, size_t *offset) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 10);
+    if (end == arg || errno != 0 || arg[0] == '-') {
+        return NULL;
+    }
+
+    int shift = 0;
+    switch (*end) {
+        case 'K': case 'k': shift = 10; end++; break;
+        case 'M': case 'm': shift = 20; end++; break;
+        case 'G': case 'g': shift = 30; end++; break;
+        default: break;
+    }
+
+    /* out of range rather than wrapped around to some other offset */
+    if (v > (SIZE_MAX >> shift)) {
+        return NULL;
+    }
+
+    *offset = (size_t)v << shift;
+    return end;
+}
+
+void _parse_range_arg(const char *arg, map_config_t *map_config, char *argv[]) {
+    size_t start = 0;
+    size_t end = SIZE_MAX;
+
+    const char *p = _parse_offset(arg, &start);
+    if (p != NULL && *p == ':') {
+        p++;
+        if (*p != '\0') {
+            p = _parse_offset(p, &end);
+        }
+    } else {
+        p = NULL;
+    }
+
+    if (p == NULL || *p != '\0' || end < start) {
+        fprintf(stderr, "Error: invalid --range '%s': expected <start>:<end> with start <= end\n", arg);
+        print_usage(argv);
+        exit(EXIT_FAILURE);
+    }
+
+    map_config->range_f = 1;
+    map_config->range_start = start;
+    map_config->range_end = end;
+}
+
+void _parse_flush_arg(const char *arg, map_config_t *map_config, char *argv[]) {
+    const char *p = NULL;
+    size_t value = 0;
+
+    if (strcmp(arg, "record") == 0) {
+        map_config->flush_policy = WRITER_FLUSH_RECORD;
+        return;
+    }
+
+    if (strncmp(arg, "block", 5) == 0) {
+        map_config->flush_policy = WRITER_FLUSH_BLOCK;
+        if (arg[5] == '\0') {
+            return;
+        }
+        if (arg[5] == ':' && (p = _parse_offset(arg + 6, &value)) != NULL && *p == '\0' && value > 0) {
+            map_config->flush_size = value;
+            return;
+        }
+    } else if (strncmp(arg, "time:", 5) == 0) {
+        char *end = NULL;
+        errno = 0;
+        long ms = strtol(arg + 5, &end, 10);
+        if (end != arg + 5 && *end == '\0' && errno == 0 && ms > 0 && ms <= INT_MAX) {
+            map_config->flush_policy = WRITER_FLUSH_TIME;
+            map_config->flush_ms = ms;
+            return;
+        }
+    }
+
+    fprintf(stderr, "Error: invalid --flush '%s': expected block[:<size>], record or time:<ms>\n", arg);
+    print_usage(argv);
+    exit(EXIT_FAILURE);
+}
+
+void _parse_shard_arg(const char *arg, map_config_t *map_config, char *argv[]) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long index = strtoull(arg, &end, 10);
+    unsigned long long count = 0;
+    int valid = end != arg && *end == '/' && arg[0] != '-' && errno == 0;
+    if (valid) {
+        const char *c = end + 1;
+        count = strtoull(c, &end, 10);
+        valid = end != c && *end == '\0' && c[0] != '-' && errno == 0 && index < count;
+    }
+
+    if (!valid) {
+        fprintf(stderr, "Error: invalid --shard '%s': expected <i>/<N> with 0 <= i < N\n", arg);
+        print_usage(argv);
+        exit(EXIT_FAILURE);
+    }
+
+    map_config->shard_f = 1;
+    map_config->shard_index = (size_t)index;
+    map_config->shard_count = (size_t)count;
+}
+
+void _parse_frame_arg(const char *arg, buffer_frame_t *frame, const char *opt, char *argv[]) {
+    if (strcmp(arg, "varint") == 0) {
+        *frame = BUFFER_FRAME_VARINT;
+    } else if (strcmp(arg, "u32le") == 0) {
+        *frame = BUFFER_FRAME_U32LE;
+    } else if (strcmp(arg, "u32be") == 0) {
+        *frame = BUFFER_FRAME_U32BE;
+    } else {
+        fprintf(stderr, "Error: invalid %s '%s': expected varint, u32le or u32be\n", opt, arg);
+        print_usage(argv);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void _parse_split_arg(const char *arg, map_config_t *map_config, char *argv[]) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long count = strtoull(arg, &end, 10);
+    if (end == arg || *end != ':' || end[1] == '\0' || arg[0] == '-' || errno != 0 ||
+        count == 0 || count > INT_MAX) {
+        fprintf(stderr, "Error: invalid --split-output '%s': expected <N>:<path-prefix> with N > 0\n", arg);
+        print_usage(argv);
+        exit(EXIT_FAILURE);
+    }
+
+    map_config->split_count = (size_t)count;
+    map_config->split_prefix = end + 1;
+}
+
+static void _add_input(map_config_t *map_config, const char *path) {
+    assert_faccessible(path);
+
+    const char **ipaths = realloc(map_config->ipaths, (map_config->ipaths_len + 1) * sizeof(char*));
+    if (ipaths == NULL) {
+        perror("--input");
+        exit(EXIT_FAILURE);
+    }
+    ipaths[map_config->ipaths_len++] = path;
+    map_config->ipaths = ipaths;
 }
 
 void map_config_load_from_args(map_config_t *map_config, int *argc, char **argv[]) {
@@ -69,10 +296,25 @@ void map_config_load_from_args(map_config_t *map_config, int *argc, char **argv[
         {"value-file", required_argument, 0, 'f'},
         {"value-cmd", no_argument, 0, 'r'},
         {"discard-input", no_argument, 0, 'z'},
+        {"input", required_argument, 0, 'i'},
+        {"io-uring", no_argument, 0, 'u'},
+        {"null", no_argument, 0, '0'},
+        {"range", required_argument, 0, 'R'},
+        {"shard", required_argument, 0, 'S'},
+        {"keep-order", no_argument, 0, 'k'},
+        {"flush", required_argument, 0, 'F'},
+        {"tag", required_argument, 0, 'T'},
+        {"merge", no_argument, 0, 'M'},
+        {"split-output", required_argument, 0, 'X'},
+        {"split-by", required_argument, 0, 'Y'},
+        {"framed", required_argument, 0, 'B'},
+        {"framed-input", required_argument, 0, 'P'},
+        {"framed-output", required_argument, 0, 'O'},
+        {"field-delimiter", required_argument, 0, 'd'},
         {0, 0, 0, 0}
     };
 
-    while ((opt = getopt_long(*argc, *argv, "zs:c:v:I:", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(*argc, *argv, "z0s:c:d:v:I:", long_options, NULL)) != -1) {
         switch (opt) {
             case 'v':
                 if (map_config->vsource_t == MAP_VALUE_SOURCE_CMD || map_config->vsource_t == MAP_VALUE_SOURCE_FILE) {
@@ -81,6 +323,7 @@ void map_config_load_from_args(map_config_t *map_config, int *argc, char **argv[
                     exit(EXIT_FAILURE);
                 }
                 map_config->vstatic = optarg;
+                map_config->vstatic_len = strlen(optarg);
                 map_config->vsource_t = MAP_VALUE_SOURCE_CMDLINE_ARG;
                 break;
             case 'f': /* --value-file option */
@@ -99,18 +342,84 @@ void map_config_load_from_args(map_config_t *map_config, int *argc, char **argv[
                 map_config->vsource_t = MAP_VALUE_SOURCE_CMD;
                 break;
             case 'I': /* -I <replstr> */
+                if (optarg[0] == '\0') {
+                    fprintf(stderr, "Error: the -I argument must not be empty\n");
+                    print_usage(*argv);
+                    exit(EXIT_FAILURE);
+                }
                 map_config->replstr = optarg;
+                map_config->replstr_len = strlen(optarg);
                 map_config->stripi_f = 0;
                 break;
+            case 'i': /* --input <file> */
+                _add_input(map_config, optarg);
+                break;
+            case 'k': /* --keep-order */
+                map_config->keep_order_f = 1;
+                break;
+            case 'u': /* --io-uring */
+                map_config->uring_f = 1;
+                break;
+            case 'R': /* --range <start>:<end> */
+                _parse_range_arg(optarg, map_config, *argv);
+                break;
+            case 'F': /* --flush <policy> */
+                _parse_flush_arg(optarg, map_config, *argv);
+                break;
+            case 'T': /* --tag seq|offset */
+                if (strcmp(optarg, "seq") == 0) {
+                    map_config->tag = MAP_TAG_SEQ;
+                } else if (strcmp(optarg, "offset") == 0) {
+                    map_config->tag = MAP_TAG_OFFSET;
+                } else {
+                    fprintf(stderr, "Error: invalid --tag '%s': expected seq or offset\n", optarg);
+                    print_usage(*argv);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'M': /* --merge */
+                map_config->merge_f = 1;
+                break;
+            case 'X': /* --split-output <N>:<path-prefix> */
+                _parse_split_arg(optarg, map_config, *argv);
+                break;
+            case 'Y': /* --split-by hash|round-robin */
+                if (strcmp(optarg, "hash") == 0 || strcmp(optarg, "round-robin") == 0) {
+                    map_config->split_rr_f = optarg[0] == 'r';
+                    break;
+                }
+                fprintf(stderr, "Error: invalid --split-by '%s': expected hash or round-robin\n", optarg);
+                print_usage(*argv);
+                exit(EXIT_FAILURE);
+            case 'B': /* --framed <format> */
+                _parse_frame_arg(optarg, &(map_config->frame_in), "--framed", *argv);
+                map_config->frame_out = map_config->frame_in;
+                break;
+            case 'P': /* --framed-input <format> */
+                _parse_frame_arg(optarg, &(map_config->frame_in), "--framed-input", *argv);
+                break;
+            case 'O': /* --framed-output <format> */
+                _parse_frame_arg(optarg, &(map_config->frame_out), "--framed-output", *argv);
+                break;
+            case 'S': /* --shard <i>/<N> */
+                _parse_shard_arg(optarg, map_config, *argv);
+                break;
             case 's':
-                _parse_single_char_arg(optarg, &(map_config->separator), opt, *argv);
+                _parse_bytes_arg(optarg, &(map_config->separator), &(map_config->separator_len), opt, *argv);
                 break;
             case 'c':
-                _parse_single_char_arg(optarg, &(map_config->concatenator), opt, *argv);
+                _parse_bytes_arg(optarg, &(map_config->concatenator), &(map_config->concatenator_len), opt, *argv);
+                break;
+            case 'd': /* -d, --field-delimiter <delimiter> */
+                _parse_bytes_arg(optarg, &(map_config->fdelim), &(map_config->fdelim_len), opt, *argv);
                 break;
             case 'z':
                 map_config->stripi_f = 1;
                 break;
+            case '0': /* -0, --null */
+                map_config->separator = "";
+                map_config->separator_len = 1;
+                break;
             case '?':
             default:
                 print_usage(*argv);
@@ -123,5 +432,10 @@ void map_config_load_from_args(map_config_t *map_config, int *argc, char **argv[
     if (map_config->vsource_t == MAP_VALUE_SOURCE_CMD) {
         map_config->cmd_argc = *argc;
         map_config->cmd_argv = *argv;
+    } else if (map_config->ipaths_len > 0 || map_config->merge_f) {
+        /* allows for --input *.log and --merge out.* */
+        for (int i = 0; i < *argc; i++) {
+            _add_input(map_config, (*argv)[i]);
+        }
     }
 }
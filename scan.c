@@ -0,0 +1,604 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: scan.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define SCAN_X86 1
+    #include <immintrin.h>
+#endif
+
+typedef size_t (*scan_kernel_t)(const char *data, size_t len, char c, size_t *offsets, size_t max);
+typedef size_t (*scan_str_kernel_t)(const char *data, size_t len, const char *sep, size_t seplen,
+                                    size_t *offsets, size_t max);
+typedef size_t (*scan_count_kernel_t)(const char *data, size_t len, char c, uint64_t *prev);
+
+/* bit masks of the quotes, backslashes and structural characters of a block of JSON text */
+typedef struct {
+    uint64_t quotes;
+    uint64_t backslashes;
+    uint64_t structurals;
+} scan_json_masks_t;
+
+typedef void (*scan_json_kernel_t)(const char *block, scan_json_masks_t *masks);
+
+static size_t scan_dispatch(const char *data, size_t len, char c, size_t *offsets, size_t max);
+static size_t scan_str_dispatch(const char *data, size_t len, const char *sep, size_t seplen,
+                                size_t *offsets, size_t max);
+static size_t scan_count_dispatch(const char *data, size_t len, char c, uint64_t *prev);
+static void scan_json_dispatch(const char *block, scan_json_masks_t *masks);
+
+static scan_kernel_t scan_kernel = scan_dispatch;
+static scan_str_kernel_t scan_str_kernel = scan_str_dispatch;
+static scan_count_kernel_t scan_count_kernel = scan_count_dispatch;
+static scan_json_kernel_t scan_json_kernel = scan_json_dispatch;
+static const char *scan_kernel_n = "scalar";
+
+static size_t scan_scalar(const char *data, size_t len, char c, size_t *offsets, size_t max) {
+    size_t n = 0;
+    for (size_t i = 0; i < len && n < max; i++) {
+        if (data[i] == c) {
+            offsets[n++] = i;
+        }
+    }
+    return n;
+}
+
+/*
+ * Walks the bits set in mask, storing base + bit index for each of them.
+ * Returns the updated number of stored offsets, never exceeding max.
+ */
+static inline size_t scan_mask_offsets(uint64_t mask, size_t base, size_t *offsets, size_t n, size_t max) {
+    while (mask != 0 && n < max) {
+        offsets[n++] = base + __builtin_ctzll(mask);
+        mask &= mask - 1;
+    }
+    return n;
+}
+
+/*
+ * Multi-byte separators: matches are never overlapping and are looked for
+ * left to right, so "aa" is found once in "aaa".
+ */
+static size_t scan_str_scalar(const char *data, size_t len, const char *sep, size_t seplen,
+                              size_t *offsets, size_t max) {
+    size_t n = 0;
+    size_t i = 0;
+
+    while (n < max && i + seplen <= len) {
+        const char *p = memchr(data + i, sep[0], len - seplen + 1 - i);
+        if (p == NULL) {
+            break;
+        }
+
+        size_t at = p - data;
+        if (memcmp(p + 1, sep + 1, seplen - 1) == 0) {
+            offsets[n++] = at;
+            i = at + seplen;
+        } else {
+            i = at + 1;
+        }
+    }
+    return n;
+}
+
+/*
+ * Verifies the candidates in mask, i.e. the positions where both the first
+ * and the last byte of sep match, and stores the offsets of the actual matches.
+ * next is the first position a match can start from, past the previous match.
+ */
+static inline size_t scan_str_candidates(uint64_t mask, size_t base, const char *data, const char *sep,
+                                         size_t seplen, size_t *next, size_t *offsets, size_t n, size_t max) {
+    while (mask != 0 && n < max) {
+        size_t at = base + __builtin_ctzll(mask);
+        mask &= mask - 1;
+
+        if (at < *next) {
+            continue;
+        }
+
+        if (seplen <= 2 || memcmp(data + at + 1, sep + 1, seplen - 2) == 0) {
+            offsets[n++] = at;
+            *next = at + seplen;
+        }
+    }
+    return n;
+}
+
+/*
+ * Completes a vectorized multi-byte scan with the scalar kernel from position from.
+ */
+static inline size_t scan_str_tail(const char *data, size_t len, const char *sep, size_t seplen, size_t from,
+                                   size_t *offsets, size_t n, size_t max) {
+    if (n >= max || from >= len) {
+        return n;
+    }
+
+    size_t tail = scan_str_scalar(data + from, len - from, sep, seplen, offsets + n, max - n);
+    for (size_t k = n; k < n + tail; k++) {
+        offsets[k] += from;
+    }
+    return n + tail;
+}
+
+/*
+ * Item counting: an item starts at every byte that is not a separator
+ * and follows one (prev tells whether the byte before data is a separator).
+ */
+static size_t scan_count_scalar(const char *data, size_t len, char c, uint64_t *prev) {
+    size_t n = 0;
+    uint64_t p = *prev;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == c) {
+            p = 1;
+        } else {
+            n += p;
+            p = 0;
+        }
+    }
+    *prev = p;
+    return n;
+}
+
+/*
+ * Counts the item starts among the width bytes whose separators are the bits set in mask,
+ * carrying over whether the last of them is a separator into prev.
+ */
+static inline size_t scan_count_mask(uint64_t mask, unsigned width, uint64_t *prev) {
+    uint64_t valid = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    uint64_t starts = ~mask & ((mask << 1) | *prev) & valid;
+    *prev = (mask >> (width - 1)) & 1;
+    return __builtin_popcountll(starts);
+}
+
+static void scan_json_scalar(const char *block, scan_json_masks_t *masks) {
+    memset(masks, 0, sizeof(scan_json_masks_t));
+    for (int i = 0; i < SCAN_JSON_BLOCK; i++) {
+        uint64_t bit = 1ULL << i;
+        switch (block[i]) {
+            case '"': masks->quotes |= bit; break;
+            case '\\': masks->backslashes |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': masks->structurals |= bit; break;
+            default: break;
+        }
+    }
+}
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse2")))
+static size_t scan_sse2(const char *data, size_t len, char c, size_t *offsets, size_t max) {
+    const __m128i needle = _mm_set1_epi8(c);
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= len && n < max; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+        uint64_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        n = scan_mask_offsets(mask, i, offsets, n, max);
+    }
+
+    if (n < max && i < len) {
+        size_t tail = scan_scalar(data + i, len - i, c, offsets + n, max - n);
+        for (size_t k = n; k < n + tail; k++) {
+            offsets[k] += i;
+        }
+        n += tail;
+    }
+    return n;
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char *data, size_t len, char c, size_t *offsets, size_t max) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= len && n < max; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + i));
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        n = scan_mask_offsets(mask, i, offsets, n, max);
+    }
+
+    if (n < max && i < len) {
+        size_t tail = scan_sse2(data + i, len - i, c, offsets + n, max - n);
+        for (size_t k = n; k < n + tail; k++) {
+            offsets[k] += i;
+        }
+        n += tail;
+    }
+    return n;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_avx512(const char *data, size_t len, char c, size_t *offsets, size_t max) {
+    const __m512i needle = _mm512_set1_epi8(c);
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len && n < max; i += 64) {
+        __m512i chunk = _mm512_loadu_si512((const void *)(data + i));
+        uint64_t mask = _mm512_cmpeq_epi8_mask(chunk, needle);
+        n = scan_mask_offsets(mask, i, offsets, n, max);
+    }
+
+    if (n < max && i < len) {
+        /* masked load: bytes past len are never touched */
+        __mmask64 valid = (1ULL << (len - i)) - 1;
+        __m512i chunk = _mm512_maskz_loadu_epi8(valid, (const void *)(data + i));
+        uint64_t mask = _mm512_mask_cmpeq_epi8_mask(valid, chunk, needle);
+        n = scan_mask_offsets(mask, i, offsets, n, max);
+    }
+    return n;
+}
+
+/*
+ * Multi-byte separators: first/last byte filter.
+ * Each block is compared against the first byte of the separator and the block
+ * seplen - 1 bytes further against its last byte: only positions where both match
+ * are verified with memcmp.
+ */
+
+__attribute__((target("sse2")))
+static size_t scan_str_sse2(const char *data, size_t len, const char *sep, size_t seplen,
+                            size_t *offsets, size_t max) {
+    const __m128i first = _mm_set1_epi8(sep[0]);
+    const __m128i last = _mm_set1_epi8(sep[seplen - 1]);
+    size_t n = 0;
+    size_t i = 0;
+    size_t next = 0;
+
+    for (; i + seplen - 1 + 16 <= len && n < max; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(data + i + seplen - 1));
+        uint64_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        n = scan_str_candidates(mask, i, data, sep, seplen, &next, offsets, n, max);
+    }
+
+    return scan_str_tail(data, len, sep, seplen, i > next ? i : next, offsets, n, max);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_str_avx2(const char *data, size_t len, const char *sep, size_t seplen,
+                            size_t *offsets, size_t max) {
+    const __m256i first = _mm256_set1_epi8(sep[0]);
+    const __m256i last = _mm256_set1_epi8(sep[seplen - 1]);
+    size_t n = 0;
+    size_t i = 0;
+    size_t next = 0;
+
+    for (; i + seplen - 1 + 32 <= len && n < max; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(data + i + seplen - 1));
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                                         _mm256_cmpeq_epi8(b, last)));
+        n = scan_str_candidates(mask, i, data, sep, seplen, &next, offsets, n, max);
+    }
+
+    return scan_str_tail(data, len, sep, seplen, i > next ? i : next, offsets, n, max);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_str_avx512(const char *data, size_t len, const char *sep, size_t seplen,
+                              size_t *offsets, size_t max) {
+    const __m512i first = _mm512_set1_epi8(sep[0]);
+    const __m512i last = _mm512_set1_epi8(sep[seplen - 1]);
+    size_t n = 0;
+    size_t i = 0;
+    size_t next = 0;
+
+    for (; i + seplen - 1 + 64 <= len && n < max; i += 64) {
+        __m512i a = _mm512_loadu_si512((const void *)(data + i));
+        __m512i b = _mm512_loadu_si512((const void *)(data + i + seplen - 1));
+        uint64_t mask = _mm512_cmpeq_epi8_mask(a, first) & _mm512_cmpeq_epi8_mask(b, last);
+        n = scan_str_candidates(mask, i, data, sep, seplen, &next, offsets, n, max);
+    }
+
+    return scan_str_tail(data, len, sep, seplen, i > next ? i : next, offsets, n, max);
+}
+
+__attribute__((target("sse2,popcnt")))
+static size_t scan_count_sse2(const char *data, size_t len, char c, uint64_t *prev) {
+    const __m128i needle = _mm_set1_epi8(c);
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+        uint64_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        n += scan_count_mask(mask, 16, prev);
+    }
+    return n + scan_count_scalar(data + i, len - i, c, prev);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t scan_count_avx2(const char *data, size_t len, char c, uint64_t *prev) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    size_t n = 0;
+    size_t i = 0;
+
+    /* two vectors at a time make for a full 64 bits mask */
+    for (; i + 64 <= len; i += 64) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(data + i + 32));
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)) |
+                        (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)) << 32;
+        n += scan_count_mask(mask, 64, prev);
+    }
+    return n + scan_count_sse2(data + i, len - i, c, prev);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static size_t scan_count_avx512(const char *data, size_t len, char c, uint64_t *prev) {
+    const __m512i needle = _mm512_set1_epi8(c);
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m512i chunk = _mm512_loadu_si512((const void *)(data + i));
+        n += scan_count_mask(_mm512_cmpeq_epi8_mask(chunk, needle), 64, prev);
+    }
+
+    if (i < len) {
+        /* masked load: bytes past len are never touched */
+        __mmask64 valid = (1ULL << (len - i)) - 1;
+        __m512i chunk = _mm512_maskz_loadu_epi8(valid, (const void *)(data + i));
+        n += scan_count_mask(_mm512_mask_cmpeq_epi8_mask(valid, chunk, needle), len - i, prev);
+    }
+    return n;
+}
+
+/*
+ * JSON classification: one comparison per character of interest.
+ * Structural characters are rare enough in a block for the mask alone to matter.
+ */
+
+__attribute__((target("sse2")))
+static inline uint64_t scan_json_eq_sse2(const __m128i chunks[4], char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    uint64_t mask = 0;
+    for (int k = 0; k < 4; k++) {
+        mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[k], needle)) << (16 * k);
+    }
+    return mask;
+}
+
+__attribute__((target("sse2")))
+static void scan_json_sse2(const char *block, scan_json_masks_t *masks) {
+    __m128i chunks[4];
+    for (int k = 0; k < 4; k++) {
+        chunks[k] = _mm_loadu_si128((const __m128i *)(block + 16 * k));
+    }
+    masks->quotes = scan_json_eq_sse2(chunks, '"');
+    masks->backslashes = scan_json_eq_sse2(chunks, '\\');
+    masks->structurals = scan_json_eq_sse2(chunks, '{') | scan_json_eq_sse2(chunks, '}') |
+                         scan_json_eq_sse2(chunks, '[') | scan_json_eq_sse2(chunks, ']') |
+                         scan_json_eq_sse2(chunks, ':') | scan_json_eq_sse2(chunks, ',');
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t scan_json_eq_avx2(__m256i lo, __m256i hi, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)) |
+           (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)) << 32;
+}
+
+__attribute__((target("avx2")))
+static void scan_json_avx2(const char *block, scan_json_masks_t *masks) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+    masks->quotes = scan_json_eq_avx2(lo, hi, '"');
+    masks->backslashes = scan_json_eq_avx2(lo, hi, '\\');
+    masks->structurals = scan_json_eq_avx2(lo, hi, '{') | scan_json_eq_avx2(lo, hi, '}') |
+                         scan_json_eq_avx2(lo, hi, '[') | scan_json_eq_avx2(lo, hi, ']') |
+                         scan_json_eq_avx2(lo, hi, ':') | scan_json_eq_avx2(lo, hi, ',');
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void scan_json_avx512(const char *block, scan_json_masks_t *masks) {
+    __m512i chunk = _mm512_loadu_si512((const void *)block);
+    masks->quotes = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('"'));
+    masks->backslashes = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\\'));
+    masks->structurals = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('{')) |
+                         _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('}')) |
+                         _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('[')) |
+                         _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8(']')) |
+                         _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8(':')) |
+                         _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8(','));
+}
+
+#endif // SCAN_X86
+
+static void scan_select_kernel(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        scan_kernel = scan_avx512;
+        scan_str_kernel = scan_str_avx512;
+        scan_count_kernel = scan_count_avx512;
+        scan_json_kernel = scan_json_avx512;
+        scan_kernel_n = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        scan_kernel = scan_avx2;
+        scan_str_kernel = scan_str_avx2;
+        scan_count_kernel = scan_count_avx2;
+        scan_json_kernel = scan_json_avx2;
+        scan_kernel_n = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan_kernel = scan_sse2;
+        scan_str_kernel = scan_str_sse2;
+        scan_count_kernel = scan_count_sse2;
+        scan_json_kernel = scan_json_sse2;
+        scan_kernel_n = "sse2";
+    } else {
+        scan_kernel = scan_scalar;
+        scan_str_kernel = scan_str_scalar;
+        scan_count_kernel = scan_count_scalar;
+        scan_json_kernel = scan_json_scalar;
+    }
+#else
+    scan_kernel = scan_scalar;
+    scan_str_kernel = scan_str_scalar;
+    scan_count_kernel = scan_count_scalar;
+    scan_json_kernel = scan_json_scalar;
+#endif
+}
+
+static size_t scan_dispatch(const char *data, size_t len, char c, size_t *offsets, size_t max) {
+    scan_select_kernel();
+    return scan_kernel(data, len, c, offsets, max);
+}
+
+static size_t scan_str_dispatch(const char *data, size_t len, const char *sep, size_t seplen,
+                                size_t *offsets, size_t max) {
+    scan_select_kernel();
+    return scan_str_kernel(data, len, sep, seplen, offsets, max);
+}
+
+static size_t scan_count_dispatch(const char *data, size_t len, char c, uint64_t *prev) {
+    scan_select_kernel();
+    return scan_count_kernel(data, len, c, prev);
+}
+
+static void scan_json_dispatch(const char *block, scan_json_masks_t *masks) {
+    scan_select_kernel();
+    scan_json_kernel(block, masks);
+}
+
+size_t scan_separators(const char *data, size_t len, char c, size_t *offsets, size_t max) {
+    if (len == 0 || max == 0) {
+        return 0;
+    }
+    return scan_kernel(data, len, c, offsets, max);
+}
+
+size_t scan_separators_str(const char *data, size_t len, const char *sep, size_t seplen,
+                           size_t *offsets, size_t max) {
+    if (seplen == 1) {
+        return scan_separators(data, len, sep[0], offsets, max);
+    }
+
+    if (seplen == 0 || len < seplen || max == 0) {
+        return 0;
+    }
+    return scan_str_kernel(data, len, sep, seplen, offsets, max);
+}
+
+size_t scan_count_items(const char *data, size_t len, char c, int *after_sep) {
+    if (len == 0) {
+        return 0;
+    }
+
+    uint64_t prev = *after_sep != 0;
+    size_t n = scan_count_kernel(data, len, c, &prev);
+    *after_sep = (int)prev;
+    return n;
+}
+
+/*
+ * Returns the bytes escaped by the backslashes in mask, the first byte being escaped
+ * if *carry is set. Sets *carry if the byte following the block is escaped.
+ * Backslashes are rare: walking them one by one beats branchless tricks.
+ */
+static inline uint64_t scan_json_escaped(uint64_t backslashes, int *carry) {
+    uint64_t escaped = 0;
+    if (*carry) {
+        escaped = 1;
+        backslashes &= ~1ULL;
+    }
+
+    *carry = 0;
+    while (backslashes != 0) {
+        int i = __builtin_ctzll(backslashes);
+        if (i == 63) {
+            *carry = 1;
+            break;
+        }
+        escaped |= 1ULL << (i + 1);
+        backslashes &= ~(3ULL << i);
+    }
+    return escaped;
+}
+
+/*
+ * Sets every bit from each set bit of mask up to the next one, excluded:
+ * given the quotes, the bytes inside strings (opening quotes included).
+ */
+static inline uint64_t scan_prefix_xor(uint64_t mask) {
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+    return mask;
+}
+
+size_t scan_json(const char *data, size_t len, scan_json_state_t *state, size_t *offsets, size_t max) {
+    size_t n = 0;
+    while (state->pos < len && max - n >= SCAN_JSON_BLOCK) {
+        scan_json_masks_t masks;
+        size_t avail = len - state->pos;
+        if (avail >= SCAN_JSON_BLOCK) {
+            scan_json_kernel(data + state->pos, &masks);
+        } else {
+            /* the last block, padded with blanks: no kernel reads past len */
+            char block[SCAN_JSON_BLOCK];
+            memset(block, ' ', sizeof(block));
+            memcpy(block, data + state->pos, avail);
+            scan_json_kernel(block, &masks);
+        }
+
+        uint64_t quotes = masks.quotes & ~scan_json_escaped(masks.backslashes, &state->escaped);
+        uint64_t strings = scan_prefix_xor(quotes) ^ (state->in_string ? ~0ULL : 0);
+        state->in_string = (int)(strings >> 63);
+
+        n = scan_mask_offsets((masks.structurals & ~strings) | quotes, state->pos, offsets, n, max);
+        state->pos += avail >= SCAN_JSON_BLOCK ? SCAN_JSON_BLOCK : avail;
+    }
+    return n;
+}
+
+const char *scan_find(const char *data, size_t len, char c) {
+    size_t offset;
+    if (scan_separators(data, len, c, &offset, 1) == 0) {
+        return NULL;
+    }
+    return data + offset;
+}
+
+const char *scan_kernel_name(void) {
+    if (scan_kernel == scan_dispatch) {
+        scan_select_kernel();
+    }
+    return scan_kernel_n;
+}
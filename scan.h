@@ -0,0 +1,97 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: scan.h
+ * Description: vectorized separator search
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/*
+ * Scans len bytes of data for occurrences of c and stores their offsets
+ * (relative to data) into offsets, stopping after max occurrences.
+ * Returns the number of offsets stored.
+ *
+ * The kernel (AVX-512, AVX2, SSE2 or scalar) is chosen at runtime
+ * according to what the current CPU supports.
+ */
+size_t scan_separators(const char *data, size_t len, char c, size_t *offsets, size_t max);
+
+/*
+ * Same as scan_separators for a separator made of seplen bytes (possibly including NULs).
+ * Stores the offsets of the first byte of each non-overlapping occurrence of sep.
+ * Candidates are located with a vectorized first/last byte filter and verified afterwards.
+ */
+size_t scan_separators_str(const char *data, size_t len, const char *sep, size_t seplen,
+                           size_t *offsets, size_t max);
+
+/*
+ * Counts the non-empty items starting in the len bytes of data, split by c:
+ * that is the bytes other than c following an occurrence of c.
+ * after_sep tells whether the byte right before data is c, and must be 1 at the
+ * beginning of the input: it is updated so that the input can be counted in blocks.
+ */
+size_t scan_count_items(const char *data, size_t len, char c, int *after_sep);
+
+/*
+ * Returns a pointer to the first occurrence of c in the first len bytes
+ * of data, or NULL if c cannot be found.
+ */
+const char *scan_find(const char *data, size_t len, char c);
+
+/* bytes of JSON text classified at once by scan_json */
+#define SCAN_JSON_BLOCK 64
+
+/* where scan_json stopped, so that indexing can resume later on */
+typedef struct {
+    /* bytes indexed so far */
+    size_t pos;
+
+    /* whether pos is inside a string, and whether the byte at pos is escaped */
+    int in_string;
+    int escaped;
+} scan_json_state_t;
+
+/*
+ * Indexes the structural characters of the len bytes of JSON text in data,
+ * starting from state->pos (0 at first): stores the offsets of the { } [ ] : ,
+ * outside strings and of the unescaped quotes delimiting strings.
+ * The text is classified SCAN_JSON_BLOCK bytes at a time, and scanning stops before
+ * a block whose offsets might not fit max, which must be at least SCAN_JSON_BLOCK.
+ * Returns the number of offsets stored and updates state: all of data is indexed
+ * once state->pos reaches len.
+ */
+size_t scan_json(const char *data, size_t len, scan_json_state_t *state, size_t *offsets, size_t max);
+
+/*
+ * Returns the name of the kernel selected for the current CPU.
+ */
+const char *scan_kernel_name(void);
+
+#endif // SCAN_H
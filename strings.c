@@ -38,31 +38,38 @@ static inline void fill_skip_table(int *t, const char *pattern, size_t pattern_l
         t[i] = pattern_length;
     }
 
-    for (int i = 0; i < pattern_length - 1; i++) {
-        t[pattern[i]] = pattern_length - 1 - i;
+    for (size_t i = 0; i < pattern_length - 1; i++) {
+        t[(unsigned char)pattern[i]] = pattern_length - 1 - i;
     }
 }
 
 /*
- * Finds the first occurrence of little in data and returns a pointer to it.
- * little must be 0-terminated.
+ * Finds the first occurrence of the llen bytes of little in data and returns a pointer to it.
  * It scans len bytes at most.
  */
-static const char *strfind(const char *data, const char *little, size_t len, int *skip_table) {
+static const char *strfind(const char *data, const char *little, size_t llen, size_t len, int *skip_table) {
     /* Boyer–Moore–Horspool */
-    size_t llen = strlen(little);
-
-    int skip = 0;
-    while (len - skip >= llen) {
+    size_t skip = 0;
+    while (len >= llen && len - skip >= llen) {
         if (memcmp(data + skip, little, llen) == 0) {
             return data + skip;
         }
-        skip = skip + skip_table[data[skip + llen - 1]];
+        skip = skip + skip_table[(unsigned char)data[skip + llen - 1]];
     }
 
     return NULL;
 }
 
+const char *strnfind(const char *data, size_t len, const char *little, size_t llen) {
+    if (llen == 0) {
+        return NULL;
+    }
+
+    int skip_table[256];
+    fill_skip_table(skip_table, little, llen);
+    return strfind(data, little, llen, len, skip_table);
+}
+
 typedef struct {
     char **table;
     size_t count;
@@ -108,12 +115,14 @@ static void free_matches_table(matches_table_t *t) {
 }
 
 const char *strreplall(const char *src, size_t srclen, const char *replstr, const char *v) {
-    size_t replstrlen = strlen(replstr);
+    return strnreplall(src, srclen, replstr, strlen(replstr), v, strlen(v), NULL);
+}
+
+const char *strnreplall(const char *src, size_t srclen, const char *replstr, size_t replstrlen,
+                        const char *v, size_t vlen, size_t *dstlen) {
     if (replstrlen == 0) {
         return NULL;
     }
-
-    size_t vlen = strlen(v);
     
     int skip_table[256];
     fill_skip_table(skip_table, replstr, replstrlen);
@@ -124,7 +133,7 @@ const char *strreplall(const char *src, size_t srclen, const char *replstr, cons
     const char *cur = src;
     const char *match = NULL;
 
-    while ((match = strfind(cur, replstr, srclen - (cur - src), skip_table)) != NULL) {
+    while ((match = strfind(cur, replstr, replstrlen, srclen - (cur - src), skip_table)) != NULL) {
         append_match(&matches, match);
         cur = match + replstrlen;
     }
@@ -138,10 +147,9 @@ const char *strreplall(const char *src, size_t srclen, const char *replstr, cons
     }
 
     cur = src;
-    const char *s = NULL;
     char *dst = result;
 
-    for (int i = 0; i < matches.count; i++) {
+    for (size_t i = 0; i < matches.count; i++) {
         const char *match = matches.table[i];
         /* copy from source until match index */
         size_t p = match - cur;
@@ -158,6 +166,10 @@ const char *strreplall(const char *src, size_t srclen, const char *replstr, cons
     memcpy(dst, cur, srclen - (cur - src));
     result[newsize - 1] = '\0';
 
+    if (dstlen != NULL) {
+        *dstlen = newsize - 1;
+    }
+
     free_matches_table(&matches);
     
     return result;
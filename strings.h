@@ -33,10 +33,23 @@
 
 #include <stddef.h>
 
+/*
+ * Returns a pointer to the first occurrence of the llen bytes of little
+ * in the len bytes of data, or NULL if there is none.
+ */
+const char *strnfind(const char *data, size_t len, const char *little, size_t llen);
+
 /*
  * Replaces all occurrences of replstr in src with v.
  * Always returns a new string. If no occurrences are found, returns a copy of src.
  */
 const char *strreplall(const char *src, size_t srclen, const char *replstr, const char *v);
 
+/*
+ * Same as strreplall for byte strings of explicit length, which may contain NULs.
+ * The result is still 0-terminated for convenience: its length is stored in dstlen, if not NULL.
+ */
+const char *strnreplall(const char *src, size_t srclen, const char *replstr, size_t replstrlen,
+                        const char *v, size_t vlen, size_t *dstlen);
+
 #endif // STRINGS_H
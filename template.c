@@ -0,0 +1,439 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: template.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "template.h"
+#include "strings.h"
+#include "scan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* field delimiters collected by a single scan */
+#define TEMPLATE_SPLIT_BATCH 64
+
+/* the value of a segment being bound: bytes of the item or of the template, or of the scratch at off */
+typedef struct {
+    const char *data;
+    size_t off;
+    size_t len;
+} template_val_t;
+
+static int template_add(template_t *t, size_t *cap, template_seg_t seg) {
+    if (seg.kind == TEMPLATE_LITERAL && seg.len == 0) {
+        return 0;
+    }
+
+    if (t->nsegs == *cap) {
+        size_t newcap = *cap > 0 ? *cap * 2 : 4;
+        template_seg_t *segs = realloc(t->segs, newcap * sizeof(template_seg_t));
+        if (segs == NULL) {
+            return -1;
+        }
+        t->segs = segs;
+        *cap = newcap;
+    }
+
+    t->segs[t->nsegs++] = seg;
+    if (seg.kind == TEMPLATE_LITERAL) {
+        t->literal_len += seg.len;
+    } else {
+        t->nslots++;
+    }
+    if (seg.kind == TEMPLATE_FIELD && seg.field > t->max_field) {
+        t->max_field = seg.field;
+    }
+    return 0;
+}
+
+static int template_add_fn(template_t *t, size_t *cap, transform_t fn) {
+    if (t->nfns == *cap) {
+        size_t newcap = *cap > 0 ? *cap * 2 : 4;
+        transform_t *fns = realloc(t->fns, newcap * sizeof(transform_t));
+        if (fns == NULL) {
+            return -1;
+        }
+        t->fns = fns;
+        *cap = newcap;
+    }
+    t->fns[t->nfns++] = fn;
+    return 0;
+}
+
+/*
+ * Parses the placeholder in braces starting at p into seg, adding its transforms to t,
+ * and sets len to its length.
+ * Returns 1 on success, 0 if p does not start a placeholder, which is then just literal text,
+ * and -1 if out of memory.
+ */
+static int template_parse_placeholder(template_t *t, size_t *fncap, const char *p, const char *end,
+                                      template_seg_t *seg, size_t *len) {
+    const char *q = p + 1;
+    *seg = (template_seg_t){ .kind = TEMPLATE_ITEM, .fn = t->nfns };
+
+    size_t pathlen = json_path_parse(q, end - q);
+    int source = 1;
+    if (pathlen > 0) {
+        *seg = (template_seg_t){ .kind = TEMPLATE_JSON, .data = q, .len = pathlen, .fn = t->nfns };
+        q += pathlen;
+    } else if (q < end && *q >= '0' && *q <= '9') {
+        size_t field = 0;
+        while (q < end && *q >= '0' && *q <= '9' && field < 1000000) {
+            field = field * 10 + (size_t)(*q++ - '0');
+        }
+        if (field > 0) {
+            seg->kind = TEMPLATE_FIELD;
+            seg->field = field;
+        }
+    } else {
+        /* {upper}: the whole item, transformed */
+        source = 0;
+    }
+
+    /* transforms, each following a | but the first one of {upper} */
+    int pipe = source;
+    while (q < end && *q != '}') {
+        if (pipe) {
+            if (*q != '|') {
+                break;
+            }
+            q++;
+        }
+        pipe = 1;
+
+        transform_t fn;
+        size_t n = transform_parse(q, end - q, &fn);
+        if (n == 0) {
+            t->nfns = seg->fn;
+            return 0;
+        }
+        if (template_add_fn(t, fncap, fn) != 0) {
+            return -1;
+        }
+        seg->nfns++;
+        q += n;
+    }
+
+    if (q == end || *q != '}' || (!source && seg->nfns == 0)) {
+        t->nfns = seg->fn;
+        return 0;
+    }
+    *len = q + 1 - p;
+    return 1;
+}
+
+int template_compile(template_t *t, const char *src, size_t len, const char *replstr, size_t replstr_len,
+                     const template_opts_t *opts) {
+    memset(t, 0, sizeof(template_t));
+    if (opts != NULL) {
+        t->delim = opts->delim;
+        t->delim_len = opts->delim_len;
+    }
+    size_t cap = 0;
+    size_t fncap = 0;
+
+    const char *end = src + len;
+    const char *lit = src;
+    const char *p = src;
+
+    /* next occurrence of replstr, only looked for again once p is past it */
+    const char *at = strnfind(p, end - p, replstr, replstr_len);
+    while (p < end) {
+        if (at != NULL && at < p) {
+            at = strnfind(p, end - p, replstr, replstr_len);
+        }
+        const char *stop = at != NULL ? at : end;
+
+        const char *brace = NULL;
+        if (opts != NULL && opts->placeholders) {
+            brace = memchr(p, '{', stop - p);
+        }
+
+        if (brace != NULL) {
+            template_seg_t seg;
+            size_t n;
+            int r = template_parse_placeholder(t, &fncap, brace, end, &seg, &n);
+            if (r == 0) {
+                p = brace + 1;
+                continue;
+            }
+            if (r == -1 || template_add(t, &cap, (template_seg_t){ .data = lit, .len = brace - lit }) != 0 ||
+                template_add(t, &cap, seg) != 0) {
+                template_free(t);
+                return -1;
+            }
+            p = lit = brace + n;
+            continue;
+        }
+
+        if (at == NULL) {
+            break;
+        }
+        if (template_add(t, &cap, (template_seg_t){ .data = lit, .len = at - lit }) != 0 ||
+            template_add(t, &cap, (template_seg_t){ .kind = TEMPLATE_ITEM }) != 0) {
+            template_free(t);
+            return -1;
+        }
+        p = lit = at + replstr_len;
+    }
+
+    if (template_add(t, &cap, (template_seg_t){ .data = lit, .len = end - lit }) != 0) {
+        template_free(t);
+        return -1;
+    }
+    return 0;
+}
+
+void template_free(template_t *t) {
+    free(t->segs);
+    free(t->fns);
+    memset(t, 0, sizeof(template_t));
+}
+
+void template_ctx_init(template_ctx_t *ctx) {
+    memset(ctx, 0, sizeof(template_ctx_t));
+    json_index_init(&ctx->json);
+}
+
+void template_ctx_free(template_ctx_t *ctx) {
+    free(ctx->seps);
+    free(ctx->views);
+    free(ctx->offs);
+    free(ctx->scratch);
+    json_index_free(&ctx->json);
+    template_ctx_init(ctx);
+}
+
+void template_ctx_set(template_ctx_t *ctx, const char *item, size_t len) {
+    ctx->item = item;
+    ctx->itemlen = len;
+    ctx->nseps = 0;
+    ctx->scanned = 0;
+    ctx->split = 0;
+    json_index_set(&ctx->json, item, len);
+}
+
+/*
+ * Makes room for len more bytes of scratch. Returns 0 on success, -1 if out of memory.
+ * The scratch may move meanwhile: values in there are only pointed to once all the segments are bound.
+ */
+static int template_scratch(template_ctx_t *ctx, size_t len) {
+    if (ctx->scratchcap - ctx->scratchlen < len) {
+        size_t cap = ctx->scratchcap * 2 + len;
+        char *scratch = realloc(ctx->scratch, cap);
+        if (scratch == NULL) {
+            return -1;
+        }
+        ctx->scratch = scratch;
+        ctx->scratchcap = cap;
+    }
+    return 0;
+}
+
+/*
+ * Sets val to the JSON value at the path of seg, empty if there is none.
+ * Escaped strings are decoded into the scratch.
+ */
+static int template_json(const template_seg_t *seg, template_ctx_t *ctx, template_val_t *val) {
+    json_value_t value;
+    int r = json_get(&ctx->json, seg->data, seg->len, &value);
+    if (r != 1) {
+        *val = (template_val_t){ .data = "", .len = 0 };
+        return r;
+    }
+
+    if (!value.string || memchr(value.data, '\\', value.len) == NULL) {
+        *val = (template_val_t){ .data = value.data, .len = value.len };
+        return 0;
+    }
+
+    if (template_scratch(ctx, value.len) != 0) {
+        return -1;
+    }
+    *val = (template_val_t){ .off = ctx->scratchlen };
+    val->len = json_unescape(value.data, value.len, ctx->scratch + ctx->scratchlen);
+    ctx->scratchlen += val->len;
+    return 0;
+}
+
+/*
+ * Applies fn to val: transforms selecting a part of their input narrow val,
+ * the others write their result to the scratch.
+ */
+static int template_transform(const transform_t *fn, template_ctx_t *ctx, template_val_t *val) {
+    size_t max = transform_max_len(fn, val->len);
+    if (max > 0 && template_scratch(ctx, max) != 0) {
+        return -1;
+    }
+
+    char *dst = max > 0 ? ctx->scratch + ctx->scratchlen : NULL;
+    const char *src = val->data != NULL ? val->data : ctx->scratch + val->off;
+    const char *out;
+    size_t len = transform_apply(fn, src, val->len, dst, &out);
+
+    if (len == 0) {
+        *val = (template_val_t){ .data = "", .len = 0 };
+    } else if (dst != NULL && out == dst) {
+        *val = (template_val_t){ .off = ctx->scratchlen, .len = len };
+        ctx->scratchlen += len;
+    } else if (val->data != NULL) {
+        *val = (template_val_t){ .data = out, .len = len };
+    } else {
+        *val = (template_val_t){ .off = val->off + (out - src), .len = len };
+    }
+    return 0;
+}
+
+/*
+ * Splits the item of ctx on delim until the end of its nfields-th field is known.
+ */
+static int template_split(template_ctx_t *ctx, const char *delim, size_t delim_len, size_t nfields) {
+    if (ctx->delim != delim || ctx->delim_len != delim_len) {
+        /* fields of another delimiter */
+        ctx->delim = delim;
+        ctx->delim_len = delim_len;
+        ctx->nseps = 0;
+        ctx->scanned = 0;
+        ctx->split = 0;
+    }
+
+    while (!ctx->split && ctx->nseps < nfields) {
+        if (ctx->sepcap - ctx->nseps < TEMPLATE_SPLIT_BATCH) {
+            size_t cap = ctx->sepcap * 2 + TEMPLATE_SPLIT_BATCH;
+            size_t *seps = realloc(ctx->seps, cap * sizeof(size_t));
+            if (seps == NULL) {
+                return -1;
+            }
+            ctx->seps = seps;
+            ctx->sepcap = cap;
+        }
+
+        size_t *found = ctx->seps + ctx->nseps;
+        size_t n = scan_separators_str(ctx->item + ctx->scanned, ctx->itemlen - ctx->scanned, delim, delim_len,
+                                       found, TEMPLATE_SPLIT_BATCH);
+        for (size_t i = 0; i < n; i++) {
+            found[i] += ctx->scanned;
+        }
+        ctx->nseps += n;
+
+        if (n < TEMPLATE_SPLIT_BATCH) {
+            ctx->split = 1;
+        } else {
+            ctx->scanned = found[n - 1] + delim_len;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Returns the field-th field of the item of ctx, split already, empty if there is no such field.
+ */
+static template_view_t template_field(const template_ctx_t *ctx, size_t field) {
+    if (field > ctx->nseps + 1) {
+        return (template_view_t){ ctx->item + ctx->itemlen, 0 };
+    }
+
+    size_t start = field == 1 ? 0 : ctx->seps[field - 2] + ctx->delim_len;
+    size_t end = field <= ctx->nseps ? ctx->seps[field - 1] : ctx->itemlen;
+    return (template_view_t){ ctx->item + start, end - start };
+}
+
+int template_bind(const template_t *t, template_ctx_t *ctx, size_t *len) {
+    if (ctx->viewcap < t->nsegs) {
+        template_view_t *views = realloc(ctx->views, t->nsegs * sizeof(template_view_t));
+        if (views != NULL) {
+            ctx->views = views;
+        }
+        size_t *offs = realloc(ctx->offs, t->nsegs * sizeof(size_t));
+        if (offs != NULL) {
+            ctx->offs = offs;
+        }
+        if (views == NULL || offs == NULL) {
+            return -1;
+        }
+        ctx->viewcap = t->nsegs;
+    }
+
+    if (t->max_field > 0 && template_split(ctx, t->delim, t->delim_len, t->max_field) != 0) {
+        return -1;
+    }
+
+    ctx->scratchlen = 0;
+    size_t total = 0;
+    for (size_t i = 0; i < t->nsegs; i++) {
+        const template_seg_t *seg = &t->segs[i];
+        template_val_t val = { .data = "" };
+        template_view_t field;
+        switch (seg->kind) {
+            case TEMPLATE_LITERAL:
+                val = (template_val_t){ .data = seg->data, .len = seg->len };
+                break;
+            case TEMPLATE_ITEM:
+                val = (template_val_t){ .data = ctx->item, .len = ctx->itemlen };
+                break;
+            case TEMPLATE_FIELD:
+                field = template_field(ctx, seg->field);
+                val = (template_val_t){ .data = field.data, .len = field.len };
+                break;
+            case TEMPLATE_JSON:
+                if (template_json(seg, ctx, &val) != 0) {
+                    return -1;
+                }
+                break;
+        }
+
+        for (size_t k = 0; k < seg->nfns; k++) {
+            if (template_transform(&t->fns[seg->fn + k], ctx, &val) != 0) {
+                return -1;
+            }
+        }
+
+        ctx->views[i] = (template_view_t){ val.len > 0 ? val.data : "", val.len };
+        ctx->offs[i] = val.off;
+        total += val.len;
+    }
+
+    /* the scratch is where it stays now */
+    for (size_t i = 0; i < t->nsegs && ctx->scratchlen > 0; i++) {
+        if (ctx->views[i].data == NULL) {
+            ctx->views[i].data = ctx->scratch + ctx->offs[i];
+        }
+    }
+
+    *len = total;
+    return 0;
+}
+
+size_t template_render(const template_t *t, const template_ctx_t *ctx, char *dst) {
+    char *p = dst;
+    for (size_t i = 0; i < t->nsegs; i++) {
+        memcpy(p, ctx->views[i].data, ctx->views[i].len);
+        p += ctx->views[i].len;
+    }
+    return p - dst;
+}
@@ -0,0 +1,179 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: template.h
+ * Description: map values compiled into literal segments and item slots
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include <stddef.h>
+
+#include "json.h"
+#include "transform.h"
+
+typedef enum {
+    /* bytes of the template itself */
+    TEMPLATE_LITERAL = 0,
+
+    /* the whole input item */
+    TEMPLATE_ITEM,
+
+    /* a field of the item, as split on the field delimiter */
+    TEMPLATE_FIELD,
+
+    /* a value of the item, parsed as JSON */
+    TEMPLATE_JSON
+} template_kind_t;
+
+typedef struct {
+    template_kind_t kind;
+
+    /* literal bytes (TEMPLATE_LITERAL) or path of the value (TEMPLATE_JSON), pointing into the compiled source */
+    const char *data;
+    size_t len;
+
+    /* 1-based index of the field (TEMPLATE_FIELD only) */
+    size_t field;
+
+    /* transforms applied in turn to the value of the segment: fns[fn] to fns[fn + nfns - 1] of the template */
+    size_t fn;
+    size_t nfns;
+} template_seg_t;
+
+/*
+ * A map value split once into what never changes and the slots the item goes in,
+ * so that every item renders as a few copies with no scanning nor allocation.
+ */
+typedef struct {
+    template_seg_t *segs;
+    size_t nsegs;
+
+    /* total length of the literal segments */
+    size_t literal_len;
+
+    /* number of non literal segments */
+    size_t nslots;
+
+    /* transforms of all the segments */
+    transform_t *fns;
+    size_t nfns;
+
+    /* highest field referenced, 0 if none: items are only split that far */
+    size_t max_field;
+
+    /* separator of the fields of the items */
+    const char *delim;
+    size_t delim_len;
+} template_t;
+
+typedef struct {
+    /*
+     * recognize placeholders in braces besides replstr:
+     * {N} is the N-th field of the item ({0} being the whole item)
+     * and {.path} the value at path in the item parsed as JSON (see json_path_parse).
+     * Values can go through transforms, as in {1|upper} or {.name|trim|lower},
+     * and {upper} stands for {0|upper} (see transform_parse)
+     */
+    int placeholders;
+
+    /* separator of the fields referenced by {N} */
+    const char *delim;
+    size_t delim_len;
+} template_opts_t;
+
+typedef struct {
+    const char *data;
+    size_t len;
+} template_view_t;
+
+/*
+ * The item a template renders and what has been derived from it so far: its fields
+ * and the views of each segment. Owned by whoever renders, so that templates can be
+ * shared across threads, and reused from item to item with no allocation.
+ */
+typedef struct {
+    const char *item;
+    size_t itemlen;
+
+    /* offsets of the field delimiters found in the item, and where splitting stopped */
+    size_t *seps;
+    size_t nseps;
+    size_t sepcap;
+    size_t scanned;
+    int split;
+    const char *delim;
+    size_t delim_len;
+
+    /* structural index of the item, for JSON values */
+    json_index_t json;
+
+    /* what each segment of the last bound template renders to */
+    template_view_t *views;
+    size_t viewcap;
+
+    /*
+     * rendered bytes that are not in the item nor in the template, e.g. unescaped strings,
+     * and the offsets in there of the views pointing to it
+     */
+    size_t *offs;
+    char *scratch;
+    size_t scratchlen;
+    size_t scratchcap;
+} template_ctx_t;
+
+/*
+ * Compiles the len bytes of src into t, with a slot for each occurrence of replstr
+ * and, as per opts (which may be NULL), for each placeholder.
+ * Literal segments point into src, which must outlive t.
+ * Returns 0 on success, -1 if out of memory.
+ */
+int template_compile(template_t *t, const char *src, size_t len, const char *replstr, size_t replstr_len,
+                     const template_opts_t *opts);
+void template_free(template_t *t);
+
+void template_ctx_init(template_ctx_t *ctx);
+void template_ctx_free(template_ctx_t *ctx);
+
+/*
+ * Makes the len bytes of item the one rendered with ctx from now on.
+ */
+void template_ctx_set(template_ctx_t *ctx, const char *item, size_t len);
+
+/*
+ * Resolves every segment of t for the item of ctx and sets len to the length of t rendered.
+ * Returns 0 on success, -1 if out of memory.
+ */
+int template_bind(const template_t *t, template_ctx_t *ctx, size_t *len);
+
+/*
+ * Renders t, as last bound to ctx, into dst, which must hold the length set by template_bind.
+ * Returns the number of bytes written.
+ */
+size_t template_render(const template_t *t, const template_ctx_t *ctx, char *dst);
+
+#endif // TEMPLATE_H
@@ -0,0 +1,327 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: test_buffers.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_buffers.h"
+#include "buffers.h"
+#include "files.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+/*
+ * Returns the read end of a pipe holding len bytes of data, to be read in short reads.
+ */
+static int _pipe_with(const char *data, size_t len) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    assert(write(fds[1], data, len) == (ssize_t)len);
+    close(fds[1]);
+    return fds[0];
+}
+
+void test_buffer_reader_items_span_refills(void) {
+    char input[] = "short\na-much-longer-item-than-the-window\n\nx\nlast";
+    const char *expected[] = { "short", "a-much-longer-item-than-the-window", "", "x", "last" };
+
+    int src = _pipe_with(input, strlen(input));
+
+    buffer_reader_t reader;
+    assert(buffer_reader_init(&reader, src, 8) == BUFFER_SUCCESS);
+
+    const char *item;
+    size_t len;
+    size_t n = 0;
+    while (buffer_reader_next(&reader, "\n", 1, &item, &len) > 0) {
+        assert(n < sizeof(expected) / sizeof(expected[0]));
+        assert(len == strlen(expected[n]));
+        assert(memcmp(item, expected[n], len) == 0);
+        n++;
+    }
+    assert(n == sizeof(expected) / sizeof(expected[0]));
+
+    buffer_reader_free(&reader);
+    close(src);
+}
+
+void test_buffer_reader_window_constant(void) {
+    /* many short items never need a window larger than the initial one */
+    size_t count = 1000;
+    char *input = malloc(count * 4);
+    assert(input);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(input + i * 4, "abc\n", 4);
+    }
+
+    int src = _pipe_with(input, count * 4);
+
+    buffer_reader_t reader;
+    assert(buffer_reader_init(&reader, src, 64) == BUFFER_SUCCESS);
+
+    const char *item;
+    size_t len;
+    size_t n = 0;
+    while (buffer_reader_next(&reader, "\n", 1, &item, &len) > 0) {
+        assert(len == 3 && memcmp(item, "abc", 3) == 0);
+        n++;
+    }
+    assert(n == count);
+    assert(reader.buf.size == 64);
+
+    buffer_reader_free(&reader);
+    close(src);
+    free(input);
+}
+
+void test_buffer_reader_multibyte_separator(void) {
+    /* separators cut by the end of the window must still be found */
+    char input[] = "first\r\nsecond-item\r\n\r\nthird\rnot-a-separator\r\nlast\r";
+    const char *expected[] = { "first", "second-item", "", "third\rnot-a-separator", "last\r" };
+
+    for (size_t window = 3; window < 12; window++) {
+        int src = _pipe_with(input, strlen(input));
+
+        buffer_reader_t reader;
+        assert(buffer_reader_init(&reader, src, window) == BUFFER_SUCCESS);
+
+        const char *item;
+        size_t len;
+        size_t n = 0;
+        while (buffer_reader_next(&reader, "\r\n", 2, &item, &len) > 0) {
+            assert(n < sizeof(expected) / sizeof(expected[0]));
+            assert(len == strlen(expected[n]));
+            assert(memcmp(item, expected[n], len) == 0);
+            n++;
+        }
+        assert(n == sizeof(expected) / sizeof(expected[0]));
+
+        buffer_reader_free(&reader);
+        close(src);
+    }
+}
+
+/*
+ * Maps every item starting in [start, end) of fd, either in place or through read(2),
+ * appending them to out as separated by '|'.
+ */
+static size_t _read_range(int fd, int mapped, size_t start, size_t end, const char *sep, size_t seplen, char *out) {
+    buffer_reader_t reader;
+    void *map = NULL;
+    size_t maplen = 0;
+    if (mapped) {
+        map = mmap_fd(fd, &maplen);
+        assert(map != NULL);
+        buffer_reader_init_mapped(&reader, map, maplen, 0);
+    } else {
+        assert(buffer_reader_init(&reader, fd, 5) == BUFFER_SUCCESS);
+    }
+    assert(buffer_reader_set_range(&reader, start, end, seplen) == 0);
+
+    const char *item;
+    size_t len;
+    size_t n = 0;
+    while (buffer_reader_next(&reader, sep, seplen, &item, &len) > 0) {
+        memcpy(out + n, item, len);
+        n += len;
+        out[n++] = '|';
+    }
+
+    buffer_reader_free(&reader);
+    return n;
+}
+
+void test_buffer_reader_ranges_partition(void) {
+    const char *input = "alpha\r\nb\r\n\r\ncharlie\r\nd\r\nechoes";
+    const char *expected = "alpha|b||charlie|d|echoes|";
+    size_t inlen = strlen(input);
+
+    char path[] = "/tmp/map_test_rangeXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    assert(write(fd, input, inlen) == (ssize_t)inlen);
+
+    for (int mapped = 0; mapped <= 1; mapped++) {
+        /* any way of cutting the input in consecutive ranges yields every item exactly once */
+        for (size_t step = 1; step <= inlen + 1; step++) {
+            char out[128];
+            size_t n = 0;
+            for (size_t start = 0; start < inlen; start += step) {
+                n += _read_range(fd, mapped, start, start + step, "\r\n", 2, out + n);
+            }
+            assert(n == strlen(expected));
+            assert(memcmp(out, expected, n) == 0);
+        }
+    }
+
+    /* ranges are not supported on pipes */
+    int src = _pipe_with(input, inlen);
+    buffer_reader_t reader;
+    assert(buffer_reader_init(&reader, src, 16) == BUFFER_SUCCESS);
+    assert(buffer_reader_set_range(&reader, 4, 8, 2) != 0);
+    buffer_reader_free(&reader);
+    close(src);
+
+    close(fd);
+    unlink(path);
+}
+
+void test_buffer_reader_blocks(void) {
+    const char *input = "some input\nsplit in\nblocks";
+    size_t inlen = strlen(input);
+
+    int src = _pipe_with(input, inlen);
+    buffer_reader_t reader;
+    assert(buffer_reader_init(&reader, src, 4) == BUFFER_SUCCESS);
+
+    /* blocks never grow the window, and they cover the input exactly */
+    char out[64];
+    size_t n = 0;
+    const char *block;
+    ssize_t len;
+    while ((len = buffer_reader_next_block(&reader, &block)) > 0) {
+        assert(len <= 4);
+        memcpy(out + n, block, len);
+        n += len;
+    }
+    assert(len == 0);
+    assert(n == inlen);
+    assert(memcmp(out, input, n) == 0);
+    assert(reader.buf.size == 4);
+
+    buffer_reader_free(&reader);
+    close(src);
+}
+
+void test_buffer_frame_headers(void) {
+    const size_t lens[] = { 0, 1, 127, 128, 300, 16383, 16384, 0xffffffff, (size_t)1 << 40 };
+    const buffer_frame_t frames[] = { BUFFER_FRAME_VARINT, BUFFER_FRAME_U32LE, BUFFER_FRAME_U32BE };
+
+    for (size_t f = 0; f < sizeof(frames) / sizeof(frames[0]); f++) {
+        for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+            char header[BUFFER_FRAME_MAX_HEADER];
+            size_t n = buffer_frame_header(frames[f], lens[i], header);
+            if (frames[f] != BUFFER_FRAME_VARINT && lens[i] > 0xffffffff) {
+                assert(n == 0);
+                continue;
+            }
+            assert(n > 0);
+
+            /* no length is decoded from a partial header */
+            size_t hdrlen, len;
+            for (size_t avail = 0; avail < n; avail++) {
+                assert(buffer_frame_parse(frames[f], header, avail, &hdrlen, &len) == 0);
+            }
+            assert(buffer_frame_parse(frames[f], header, n, &hdrlen, &len) == 1);
+            assert(hdrlen == n && len == lens[i]);
+        }
+    }
+
+    char header[BUFFER_FRAME_MAX_HEADER];
+    assert(buffer_frame_header(BUFFER_FRAME_VARINT, 300, header) == 2);
+    assert(memcmp(header, "\xac\x02", 2) == 0);
+    assert(buffer_frame_header(BUFFER_FRAME_U32BE, 258, header) == 4);
+    assert(memcmp(header, "\x00\x00\x01\x02", 4) == 0);
+
+    /* more than 64 bits */
+    size_t hdrlen, len;
+    assert(buffer_frame_parse(BUFFER_FRAME_VARINT, "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x7f", 10, &hdrlen, &len) == -1);
+}
+
+void test_buffer_reader_frames(void) {
+    /* records hold any byte, separators included, and may outgrow the window */
+    const char input[] = "\x03" "a\nb" "\x00" "\x1a" "abcdefghijklmnopqrstuvwxyz" "\x02\x00\n";
+    const char *expected[] = { "a\nb", "", "abcdefghijklmnopqrstuvwxyz", "\0\n" };
+    const size_t expected_len[] = { 3, 0, 26, 2 };
+
+    for (size_t window = 1; window < 8; window++) {
+        int src = _pipe_with(input, sizeof(input) - 1);
+
+        buffer_reader_t reader;
+        assert(buffer_reader_init(&reader, src, window) == BUFFER_SUCCESS);
+        buffer_reader_set_frame(&reader, BUFFER_FRAME_VARINT);
+
+        const char *item;
+        size_t len;
+        size_t n = 0;
+        int r;
+        while ((r = buffer_reader_next(&reader, "\n", 1, &item, &len)) > 0) {
+            assert(n < sizeof(expected) / sizeof(expected[0]));
+            assert(len == expected_len[n]);
+            assert(memcmp(item, expected[n], len) == 0);
+            n++;
+        }
+        assert(r == 0);
+        assert(n == sizeof(expected) / sizeof(expected[0]));
+
+        buffer_reader_free(&reader);
+        close(src);
+    }
+
+    /* a record cut by the end of the input is an error */
+    int src = _pipe_with("\x05" "abc", 4);
+    buffer_reader_t reader;
+    assert(buffer_reader_init(&reader, src, 16) == BUFFER_SUCCESS);
+    buffer_reader_set_frame(&reader, BUFFER_FRAME_VARINT);
+
+    const char *item;
+    size_t len;
+    assert(buffer_reader_next(&reader, "\n", 1, &item, &len) == -1);
+
+    buffer_reader_free(&reader);
+    close(src);
+}
+
+void test_buffer_writev_gathers(void) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    char a[] = "value";
+    char b[] = ",item";
+    struct iovec iov[2] = { { a, 5 }, { b, 5 } };
+    assert(buffer_writev(fds[1], iov, 2) == BUFFER_SUCCESS);
+    close(fds[1]);
+
+    char out[16] = {0};
+    assert(read(fds[0], out, sizeof(out)) == 10);
+    assert(strcmp(out, "value,item") == 0);
+    close(fds[0]);
+}
+
+void test_buffers(void) {
+    test_buffer_reader_items_span_refills();
+    test_buffer_reader_window_constant();
+    test_buffer_reader_multibyte_separator();
+    test_buffer_reader_ranges_partition();
+    test_buffer_reader_blocks();
+    test_buffer_frame_headers();
+    test_buffer_reader_frames();
+    test_buffer_writev_gathers();
+}
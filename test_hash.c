@@ -0,0 +1,67 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: test_hash.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_hash.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+void test_hash_xxh64_reference_values(void) {
+    assert(hash_xxh64("", 0, 0) == 0xEF46DB3751D8E999ULL);
+    assert(hash_xxh64("a", 1, 0) == 0xD24EC4F1A98C6E5BULL);
+    assert(hash_xxh64("abc", 3, 0) == 0x44BC2CF5AD770999ULL);
+
+    /* long enough to go through the 32 bytes stripes */
+    const char *s = "Nobody inspects the spammish repetition";
+    assert(hash_xxh64(s, strlen(s), 0) == 0xFBCEA83C8A378BF1ULL);
+}
+
+void test_hash_xxh64_unaligned(void) {
+    char data[128];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (char)(i * 31 + 7);
+    }
+
+    char copy[sizeof(data) + 8];
+    for (size_t offset = 1; offset < 8; offset++) {
+        for (size_t len = 0; len <= 100; len++) {
+            memcpy(copy + offset, data, len);
+            assert(hash_xxh64(copy + offset, len, 0) == hash_xxh64(data, len, 0));
+        }
+    }
+
+    assert(hash_xxh64(data, 64, 0) != hash_xxh64(data, 64, 1));
+}
+
+void test_hash(void) {
+    test_hash_xxh64_reference_values();
+    test_hash_xxh64_unaligned();
+}
@@ -0,0 +1,180 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: test_json.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_json.h"
+#include "json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Looks up path in text and checks the value found against expected, NULL if none is expected.
+ */
+static void _assert_json(const char *text, const char *path, const char *expected) {
+    json_index_t idx;
+    json_index_init(&idx);
+    json_index_set(&idx, text, strlen(text));
+
+    assert(json_path_parse(path, strlen(path)) == strlen(path));
+    json_value_t value;
+    int r = json_get(&idx, path, strlen(path), &value);
+    if (expected == NULL) {
+        assert(r == 0);
+    } else {
+        assert(r == 1);
+        assert(value.len == strlen(expected));
+        assert(memcmp(value.data, expected, value.len) == 0);
+    }
+
+    json_index_free(&idx);
+}
+
+void test_json_path_parse(void) {
+    assert(json_path_parse(".a", 2) == 2);
+    assert(json_path_parse(".a.b}", 5) == 4);
+    assert(json_path_parse(".a[0].b|upper", 13) == 7);
+    assert(json_path_parse(".[12]", 5) == 5);
+    assert(json_path_parse(".user_id", 8) == 8);
+
+    assert(json_path_parse("a", 1) == 0);
+    assert(json_path_parse(".", 1) == 0);
+    assert(json_path_parse("..a", 3) == 0);
+    assert(json_path_parse(".a[x]", 5) == 0);
+    assert(json_path_parse(".a[1", 4) == 0);
+    assert(json_path_parse("", 0) == 0);
+}
+
+void test_json_get(void) {
+    const char *doc = " {\"user\": {\"id\": 42, \"name\": \"ann\", \"tags\": [\"a\", {\"x\": [1, 2]}, true]},"
+                      " \"ok\" : false , \"n\":null, \"f\": -1.5e3 }";
+
+    _assert_json(doc, ".user.id", "42");
+    _assert_json(doc, ".user.name", "ann");
+    _assert_json(doc, ".user.tags[0]", "a");
+    _assert_json(doc, ".user.tags[1]", "{\"x\": [1, 2]}");
+    _assert_json(doc, ".user.tags[1].x[1]", "2");
+    _assert_json(doc, ".user.tags[2]", "true");
+    _assert_json(doc, ".user.tags", "[\"a\", {\"x\": [1, 2]}, true]");
+    _assert_json(doc, ".ok", "false");
+    _assert_json(doc, ".n", "null");
+    _assert_json(doc, ".f", "-1.5e3");
+
+    /* missing values */
+    _assert_json(doc, ".missing", NULL);
+    _assert_json(doc, ".user.tags[3]", NULL);
+    _assert_json(doc, ".user.id.x", NULL);
+    _assert_json(doc, ".user[0]", NULL);
+    _assert_json("[]", ".[0]", NULL);
+    _assert_json("{}", ".a", NULL);
+    _assert_json("", ".a", NULL);
+    _assert_json("not json", ".a", NULL);
+    _assert_json("{\"a\": [1, 2", ".b", NULL);
+
+    /* structural characters and escaped quotes inside strings are not structural */
+    _assert_json("{\"a\": \"{[,:]}\", \"b\": 1}", ".b", "1");
+    _assert_json("{\"a\\\"b\": \"x\\\"\", \"c\": 2}", ".c", "2");
+    _assert_json("{\"a\": \"x\\\\\", \"c\": 3}", ".c", "3");
+    _assert_json("{\"a\": \"x\\\\\", \"c\": 3}", ".a", "x\\\\");
+
+    /* top level arrays, and the first of duplicate keys */
+    _assert_json("[10, [20, 30]]", ".[1][0]", "20");
+    _assert_json("{\"a\": 1, \"a\": 2}", ".a", "1");
+}
+
+void test_json_long(void) {
+    /* values past the first blocks, with a string across a block boundary */
+    size_t n = 3000;
+    char *doc = malloc(n * 16 + 64);
+    char *p = doc;
+    p += sprintf(p, "{\"pad\": \"");
+    for (size_t i = 0; i < 100; i++) {
+        *p++ = i % 2 == 0 ? '{' : ',';
+    }
+    p += sprintf(p, "\", \"list\": [");
+    for (size_t i = 0; i < n; i++) {
+        p += sprintf(p, "%s%zu", i > 0 ? "," : "", i);
+    }
+    p += sprintf(p, "], \"last\": \"end\"}");
+
+    _assert_json(doc, ".list[0]", "0");
+    _assert_json(doc, ".list[2999]", "2999");
+    _assert_json(doc, ".last", "end");
+
+    free(doc);
+}
+
+void test_json_index_reuse(void) {
+    json_index_t idx;
+    json_index_init(&idx);
+    json_value_t value;
+
+    /* several lookups share the index, built as far as the furthest of them */
+    const char *first = "{\"a\": 1, \"b\": {\"c\": 2}, \"d\": 3}";
+    json_index_set(&idx, first, strlen(first));
+    assert(json_get(&idx, ".a", 2, &value) == 1 && value.len == 1 && value.data[0] == '1');
+    assert(json_get(&idx, ".b.c", 4, &value) == 1 && value.data[0] == '2');
+    assert(json_get(&idx, ".d", 2, &value) == 1 && value.data[0] == '3');
+
+    const char *second = "{\"d\": \"x\"}";
+    json_index_set(&idx, second, strlen(second));
+    assert(json_get(&idx, ".d", 2, &value) == 1 && value.string && value.len == 1 && value.data[0] == 'x');
+    assert(json_get(&idx, ".a", 2, &value) == 0);
+
+    json_index_free(&idx);
+}
+
+static void _assert_unescapes(const char *src, const char *expected, size_t expected_len) {
+    char out[64];
+    size_t n = json_unescape(src, strlen(src), out);
+    assert(n == expected_len);
+    assert(memcmp(out, expected, n) == 0);
+}
+
+void test_json_unescape(void) {
+    _assert_unescapes("plain", "plain", 5);
+    _assert_unescapes("a\\\"b\\\\c\\/d", "a\"b\\c/d", 7);
+    _assert_unescapes("\\n\\t\\r\\b\\f", "\n\t\r\b\f", 5);
+    _assert_unescapes("\\u0041\\u00e9\\u20ac", "A\xc3\xa9\xe2\x82\xac", 6);
+    _assert_unescapes("\\ud83d\\ude00", "\xf0\x9f\x98\x80", 4);
+    _assert_unescapes("\\u0000", "\0", 1);
+
+    /* invalid escapes are kept */
+    _assert_unescapes("\\q\\u12", "\\q\\u12", 6);
+    _assert_unescapes("end\\", "end\\", 4);
+}
+
+void test_json(void) {
+    test_json_path_parse();
+    test_json_get();
+    test_json_long();
+    test_json_index_reuse();
+    test_json_unescape();
+}
@@ -41,61 +41,62 @@
 
 #include "map.h"
 
-char** _map_repl_argv(const char *replstr, const char *v, int argc, char *argv[]);
-void test__map_replcmdargs(void) {
-    int cmd_argc = 4;
-    char *args[] = { "program", "arg1", "argtorepl", "arg3" };
-    char replstr[] = "argtorepl";
-    char item[] = "arg2";
-
-    char **replargs = _map_repl_argv(replstr, item, cmd_argc, args);
-    assert(replargs);
-
-    assert(strcmp(replargs[2], item) == 0);
-
-    free(replargs);
-}
-
-void test__map_replcmdargs_multi_occurs(void) {
-    int cmd_argc = 4;
-    char *args[] = { "program", "arg1", "complex{}arg{}", "arg3" };
-    char replstr[] = "{}";
-    char item[] = "__";
-
-    char **replargs = _map_repl_argv(replstr, item, cmd_argc, args);
-
-    assert(replargs);
-    assert(strcmp(replargs[2], "complex__arg__") == 0);
+/*
+ * Renders the compiled value of config for the len bytes of item and checks the result against expected.
+ */
+static void _assert_config_renders(const map_config_t *config, const char *item, size_t len,
+                                   const char *expected, size_t expected_len) {
+    assert(config->vtemplate != NULL);
+
+    template_ctx_t ctx;
+    template_ctx_init(&ctx);
+    template_ctx_set(&ctx, item, len);
+
+    char out[64];
+    size_t rendered;
+    assert(template_bind(config->vtemplate, &ctx, &rendered) == 0);
+    assert(rendered == expected_len && rendered <= sizeof(out));
+    assert(template_render(config->vtemplate, &ctx, out) == expected_len);
+    assert(memcmp(out, expected, expected_len) == 0);
+
+    template_ctx_free(&ctx);
 }
 
 void test_mvload_cmdline_replstr(void) {
     map_config_t config;
+    map_config_init(&config);
     config.vsource_t = MAP_VALUE_SOURCE_CMDLINE_ARG;
     config.replstr = "@@@";
+    config.replstr_len = strlen(config.replstr);
     config.vstatic = "Hello @@@!";
+    config.vstatic_len = strlen(config.vstatic);
 
-    map_value_t ctx;
-    ctx.item = "World";
-    ctx.pos = 0;
-    ctx.msource = NULL;
+    assert(map_config_compile(&config) == 0);
+    _assert_config_renders(&config, "World", 5, "Hello World!", 12);
 
-    map_vload(&config, &ctx);
-    
-    assert(strcmp(ctx.msource, "Hello World!") == 0);
-    free((void*)ctx.msource);
+    map_config_free(&config);
+    assert(config.vtemplate == NULL);
 }
 
 void test_mvclose_cmdline_replstr(void) {
     map_config_t config;
+    map_config_init(&config);
     config.vsource_t = MAP_VALUE_SOURCE_CMDLINE_ARG;
     config.replstr = "@@@";
+    config.replstr_len = strlen(config.replstr);
     config.vstatic = "Hello @@@!";
+    config.vstatic_len = strlen(config.vstatic);
+    assert(map_config_compile(&config) == 0);
 
+    /* the value itself is the -v argument, never a copy */
     map_value_t ctx;
-    ctx.msource = calloc(42, sizeof(char));
+    map_value_init(&ctx);
+    map_vload(&config, &ctx);
+    assert(ctx.msource == config.vstatic);
 
     map_vclose(&config, &ctx);
     assert(ctx.msource == NULL);
+    map_config_free(&config);
 }
 
 int _create_test_file(size_t size_mb, char *template, const char *pattern) {
@@ -156,12 +157,14 @@ size_t _count_occurrences(const char *str, const char *substr, size_t max_length
 void test_perf_mvload_bigfile_replstr(void) {
     printf("====== Begin perf. test - map_vload bigfile replstr ======\n");
     map_config_t config;
+    map_config_init(&config);
     config.vsource_t = MAP_VALUE_SOURCE_FILE;
 
     const char replstr[] = "@@@@";
     const char pattern[] = "String pattern with substring @@@@ to replace";
     
     config.replstr = replstr;
+    config.replstr_len = strlen(replstr);
 
     char ftemplate[] = "/tmp/tmp-test_mvload_bigfile_replstr-XXXXXX";
     int tmpfd = _create_test_file(10, ftemplate, pattern);
@@ -179,10 +182,10 @@ void test_perf_mvload_bigfile_replstr(void) {
 
     config.vfpath = ftemplate;
     
-    map_value_t ctx;
-    ctx.item = "Map Rocks!";
-    ctx.msource = NULL;
-    ctx.mlen = 0;
+    const char item[] = "Map Rocks!";
+    template_ctx_t ctx;
+    template_ctx_init(&ctx);
+    template_ctx_set(&ctx, item, strlen(item));
 
     size_t pattern_length = strlen(pattern);
     size_t occurrences_per_pattern = 1;
@@ -197,7 +200,14 @@ void test_perf_mvload_bigfile_replstr(void) {
     struct timeval start_time, end_time;
     gettimeofday(&start_time, NULL);
 
-    map_vload(&config, &ctx);
+    /* the file is compiled once, then rendered for the item */
+    assert(map_config_compile(&config) == 0);
+    size_t rendered_len;
+    assert(template_bind(config.vtemplate, &ctx, &rendered_len) == 0);
+    char *rendered = malloc(rendered_len + 1);
+    assert(rendered != NULL);
+    assert(template_render(config.vtemplate, &ctx, rendered) == rendered_len);
+    rendered[rendered_len] = '\0';
 
     gettimeofday(&end_time, NULL);
     getrusage(RUSAGE_SELF, &end_usage);
@@ -210,16 +220,15 @@ void test_perf_mvload_bigfile_replstr(void) {
     double sys_time = (end_usage.ru_stime.tv_sec - start_usage.ru_stime.tv_sec) +
                      ((end_usage.ru_stime.tv_usec - start_usage.ru_stime.tv_usec) / 1000000.0);
 
-    assert(ctx.msource != NULL);
     printf("File mapped & replaced successfully, size: %lld bytes (%.2f MB)\n", 
         sb.st_size, sb.st_size / (1024.0 * 1024.0));
 
     // Sample first 1MB to verify actual occurrences match expected
     size_t sample_size = 1024 * 1024;
-    if (sample_size > sb.st_size) sample_size = sb.st_size;
+    if (sample_size > rendered_len) sample_size = rendered_len;
 
-    size_t replaced_count = _count_occurrences(ctx.msource, ctx.item, sample_size);
-    size_t remaining_count = _count_occurrences(ctx.msource, replstr, sample_size);
+    size_t replaced_count = _count_occurrences(rendered, item, sample_size);
+    size_t remaining_count = _count_occurrences(rendered, replstr, sample_size);
 
     printf("\nReplacement Results:\n");
     printf("Original string occurrences remaining: %zu (should be 0)\n", remaining_count);
@@ -251,16 +260,238 @@ void test_perf_mvload_bigfile_replstr(void) {
             
     close(tmpfd);
     unlink(ftemplate);
-    map_vclose(&config, &ctx);
+    free(rendered);
+    template_ctx_free(&ctx);
+    map_config_free(&config);
 
     printf("====== End perf. test - map_vload bigfile replstr ======\n");
 }
 
+void test_mvload_cmdline_replstr_item_view(void) {
+    map_config_t config;
+    map_config_init(&config);
+    config.vsource_t = MAP_VALUE_SOURCE_CMDLINE_ARG;
+    config.replstr = "{}";
+    config.replstr_len = 2;
+    config.vstatic = "<{}>";
+    config.vstatic_len = 4;
+
+    /* the item is a view into the input: it is not 0-terminated */
+    const char input[] = "first\nsecond\n";
+
+    assert(map_config_compile(&config) == 0);
+    _assert_config_renders(&config, input + 6, 6, "<second>", 8);
+
+    map_config_free(&config);
+}
+
+void test_mvread_binary_value_file(void) {
+    /* values are length tracked: embedded NULs must not truncate them */
+    const char content[] = "head\0@@\0tail";
+    size_t content_len = sizeof(content) - 1;
+
+    char ftemplate[] = "/tmp/tmp-test_mvread_binary_value_file-XXXXXX";
+    int fd = mkstemp(ftemplate);
+    assert(fd != -1);
+    assert(write(fd, content, content_len) == (ssize_t)content_len);
+    close(fd);
+
+    map_config_t config;
+    map_config_init(&config);
+    config.vsource_t = MAP_VALUE_SOURCE_FILE;
+    config.vfpath = ftemplate;
+    config.replstr = "@@";
+    config.replstr_len = 2;
+
+    assert(map_config_compile(&config) == 0);
+    const char expected[] = "head\0x\0y\0tail";
+    _assert_config_renders(&config, "x\0y", 3, expected, sizeof(expected) - 1);
+
+    /* the loaded value is the file itself */
+    map_value_t ctx;
+    map_value_init(&ctx);
+    map_vload(&config, &ctx);
+
+    char out[64];
+    size_t total = 0;
+    while (!map_veof(&config, &ctx)) {
+        /* small reads: the value must be consumed across several calls */
+        total += map_vread(out + total, 3, &config, &ctx);
+    }
+    assert(total == content_len);
+    assert(memcmp(out, content, total) == 0);
+
+    map_vclose(&config, &ctx);
+    map_config_free(&config);
+    unlink(ftemplate);
+}
+
+void test_config_compile_value_file(void) {
+    const char content[] = "<@@>\0<@@>";
+    size_t content_len = sizeof(content) - 1;
+
+    char ftemplate[] = "/tmp/tmp-test_config_compile_value_file-XXXXXX";
+    int fd = mkstemp(ftemplate);
+    assert(fd != -1);
+    assert(write(fd, content, content_len) == (ssize_t)content_len);
+    close(fd);
+
+    map_config_t config;
+    map_config_init(&config);
+    config.vsource_t = MAP_VALUE_SOURCE_FILE;
+    config.vfpath = ftemplate;
+    config.replstr = "@@";
+    config.replstr_len = 2;
+
+    /* the file is read once, then no longer needed */
+    assert(map_config_compile(&config) == 0);
+    unlink(ftemplate);
+    assert(config.vtemplate != NULL);
+    assert(config.vtemplate->nslots == 2);
+
+    template_ctx_t ctx;
+    template_ctx_init(&ctx);
+    template_ctx_set(&ctx, "item", 4);
+
+    char out[32];
+    size_t len;
+    assert(template_bind(config.vtemplate, &ctx, &len) == 0);
+    size_t n = template_render(config.vtemplate, &ctx, out);
+    assert(n == len && n == 13);
+    assert(memcmp(out, "<item>\0<item>", n) == 0);
+    template_ctx_free(&ctx);
+
+    map_config_free(&config);
+    assert(config.vtemplate == NULL && config.vfmap == NULL);
+}
+
+/*
+ * Runs the command of config for item and checks its output against expected.
+ */
+static void _assert_cmd_output(map_config_t *config, map_value_t *ctx, const char *item, const char *expected) {
+    map_viset(ctx, item, strlen(item));
+    map_vload(config, ctx);
+
+    char out[64];
+    size_t total = 0;
+    while (!map_veof(config, ctx)) {
+        total += map_vread(out + total, sizeof(out) - total, config, ctx);
+    }
+    assert(!map_verr(config, ctx));
+    assert(total == strlen(expected));
+    assert(memcmp(out, expected, total) == 0);
+
+    map_vreset(config, ctx);
+}
+
+void test_config_compile_argv(void) {
+    char *args[] = { "echo", "<{}>", "plain", "{}{}", "{2}", NULL };
+
+    map_config_t config;
+    map_config_init(&config);
+    config.vsource_t = MAP_VALUE_SOURCE_CMD;
+    config.cmd_argc = 5;
+    config.cmd_argv = args;
+    config.replstr = "{}";
+    config.replstr_len = 2;
+
+    assert(map_config_compile(&config) == 0);
+    assert(config.cmd_templates != NULL);
+    assert(config.cmd_templates[1].nslots == 1);
+    assert(config.cmd_templates[2].nslots == 0);
+    assert(config.cmd_templates[3].nslots == 2);
+    assert(config.cmd_templates[4].nslots == 1 && config.cmd_templates[4].max_field == 2);
+
+    map_value_t ctx;
+    map_value_init(&ctx);
+    _assert_cmd_output(&config, &ctx, "a\tb", "<a\tb> plain a\tba\tb b\n");
+
+    /* the rendered arguments storage is reused by shorter items */
+    char *args_storage = ctx.args;
+    _assert_cmd_output(&config, &ctx, "c", "<c> plain cc \n");
+    assert(ctx.args == args_storage);
+
+    /* verbatim arguments are never copied */
+    assert(ctx.argv[2] == args[2]);
+
+    map_vclose(&config, &ctx);
+    map_config_free(&config);
+    assert(config.cmd_templates == NULL);
+}
+
+void test_config_compile_argv_transforms(void) {
+    /* each argument uses the scratch of the context, which the next one reuses */
+    char *args[] = { "echo", "{upper}", "{lower}", "{xxhash}", "{upper|substr:1}", NULL };
+
+    map_config_t config;
+    map_config_init(&config);
+    config.vsource_t = MAP_VALUE_SOURCE_CMD;
+    config.cmd_argc = 5;
+    config.cmd_argv = args;
+    config.replstr = "{}";
+    config.replstr_len = 2;
+    assert(map_config_compile(&config) == 0);
+
+    map_value_t ctx;
+    map_value_init(&ctx);
+    _assert_cmd_output(&config, &ctx, "aB", "AB ab 4024a2ae81e64953 B\n");
+    _assert_cmd_output(&config, &ctx, "hello world", "HELLO WORLD hello world 45ab6734b21e6968 ELLO WORLD\n");
+
+    map_vclose(&config, &ctx);
+    map_config_free(&config);
+}
+
+void test_config_compile_replcmdargs(void) {
+    char *args[] = { "echo", "arg1", "argtorepl", "arg3", NULL };
+
+    map_config_t config;
+    map_config_init(&config);
+    config.vsource_t = MAP_VALUE_SOURCE_CMD;
+    config.cmd_argc = 4;
+    config.cmd_argv = args;
+    config.replstr = "argtorepl";
+    config.replstr_len = strlen(config.replstr);
+    assert(map_config_compile(&config) == 0);
+
+    map_value_t ctx;
+    map_value_init(&ctx);
+    _assert_cmd_output(&config, &ctx, "arg2", "arg1 arg2 arg3\n");
+
+    map_vclose(&config, &ctx);
+    map_config_free(&config);
+}
+
+void test_config_compile_replcmdargs_multi_occurs(void) {
+    /* the command itself is never replaced */
+    char *args[] = { "echo", "complex@@arg@@", "arg3", NULL };
+
+    map_config_t config;
+    map_config_init(&config);
+    config.vsource_t = MAP_VALUE_SOURCE_CMD;
+    config.cmd_argc = 3;
+    config.cmd_argv = args;
+    config.replstr = "@@";
+    config.replstr_len = 2;
+    assert(map_config_compile(&config) == 0);
+
+    map_value_t ctx;
+    map_value_init(&ctx);
+    _assert_cmd_output(&config, &ctx, "__", "complex__arg__ arg3\n");
+
+    map_vclose(&config, &ctx);
+    map_config_free(&config);
+}
+
 void test_map(void) {
-    test__map_replcmdargs();
-    test__map_replcmdargs_multi_occurs();
+    test_config_compile_replcmdargs();
+    test_config_compile_replcmdargs_multi_occurs();
 
     test_mvload_cmdline_replstr();
+    test_mvload_cmdline_replstr_item_view();
     test_mvclose_cmdline_replstr();
+    test_mvread_binary_value_file();
+    test_config_compile_value_file();
+    test_config_compile_argv();
+    test_config_compile_argv_transforms();
     test_perf_mvload_bigfile_replstr();
 }
@@ -0,0 +1,209 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: test_scan.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_scan.h"
+#include "scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+void test_scan_separators_matches_scalar(void) {
+    char data[1031];
+    size_t offsets[sizeof(data)];
+
+    srand(42);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (rand() % 8 == 0) ? '\n' : 'a' + (rand() % 26);
+    }
+
+    /* exercise every alignment and tail length the vector kernels may hit */
+    for (size_t start = 0; start < 70; start++) {
+        for (size_t len = 0; start + len <= sizeof(data); len += 7) {
+            size_t n = scan_separators(data + start, len, '\n', offsets, sizeof(data));
+
+            size_t expected = 0;
+            for (size_t i = 0; i < len; i++) {
+                if (data[start + i] == '\n') {
+                    assert(expected < n);
+                    assert(offsets[expected] == i);
+                    expected++;
+                }
+            }
+            assert(n == expected);
+        }
+    }
+}
+
+void test_scan_separators_max(void) {
+    char data[] = "a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q,r,s,t,u,v,w,x,y,z,a,b,c,d,e,f,g,h";
+    size_t offsets[4];
+
+    size_t n = scan_separators(data, strlen(data), ',', offsets, 4);
+    assert(n == 4);
+    assert(offsets[0] == 1 && offsets[3] == 7);
+
+    n = scan_separators(data + 8, strlen(data) - 8, ',', offsets, 4);
+    assert(n == 4);
+    assert(offsets[0] == 1);
+}
+
+void test_scan_separators_str_matches_scalar(void) {
+    char data[1031];
+    size_t offsets[sizeof(data)];
+    const char *seps[] = { "||", "\r\n", "abc", "a|a" };
+
+    srand(7);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = "ab|c\r\n"[rand() % 6];
+    }
+
+    for (size_t s = 0; s < sizeof(seps) / sizeof(seps[0]); s++) {
+        const char *sep = seps[s];
+        size_t seplen = strlen(sep);
+
+        for (size_t start = 0; start < 70; start++) {
+            for (size_t len = 0; start + len <= sizeof(data); len += 13) {
+                const char *p = data + start;
+                size_t n = scan_separators_str(p, len, sep, seplen, offsets, sizeof(data));
+
+                /* naive, left to right and non-overlapping */
+                size_t expected = 0;
+                for (size_t i = 0; i + seplen <= len; i++) {
+                    if (memcmp(p + i, sep, seplen) == 0) {
+                        assert(expected < n);
+                        assert(offsets[expected] == i);
+                        expected++;
+                        i += seplen - 1;
+                    }
+                }
+                assert(n == expected);
+            }
+        }
+    }
+}
+
+void test_scan_find(void) {
+    char data[200];
+    memset(data, 'x', sizeof(data));
+
+    assert(scan_find(data, sizeof(data), '\n') == NULL);
+
+    data[150] = '\n';
+    assert(scan_find(data, sizeof(data), '\n') == data + 150);
+    assert(scan_find(data, 150, '\n') == NULL);
+}
+
+void test_scan_count_items(void) {
+    char data[1031];
+
+    srand(7);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        /* plenty of consecutive separators, i.e. empty items */
+        data[i] = (rand() % 3 == 0) ? ',' : 'a';
+    }
+
+    size_t expected = 0;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        if (data[i] != ',' && (i == 0 || data[i - 1] == ',')) {
+            expected++;
+        }
+    }
+
+    /* counting in blocks of any size gives the same result */
+    for (size_t block = 1; block <= 200; block++) {
+        int after_sep = 1;
+        size_t n = 0;
+        for (size_t i = 0; i < sizeof(data); i += block) {
+            size_t len = i + block <= sizeof(data) ? block : sizeof(data) - i;
+            n += scan_count_items(data + i, len, ',', &after_sep);
+        }
+        assert(n == expected);
+        assert(after_sep == (data[sizeof(data) - 1] == ','));
+    }
+
+    int after_sep = 1;
+    assert(scan_count_items("\0a\0\0bc\0", 7, '\0', &after_sep) == 2);
+    assert(after_sep == 1);
+    after_sep = 0;
+    assert(scan_count_items("a,b", 3, ',', &after_sep) == 1);
+}
+
+void test_scan_json_matches_scalar(void) {
+    static const char alphabet[] = "{}[]:,\"\\ a1";
+    char data[1031];
+    size_t offsets[sizeof(data)];
+    size_t expected[sizeof(data)];
+
+    srand(11);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+    }
+
+    /* reference: a byte at a time */
+    size_t nexpected = 0;
+    int in_string = 0;
+    int escaped = 0;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        char c = data[i];
+        int esc = escaped;
+        escaped = 0;
+        if (c == '\\' && !esc) {
+            escaped = 1;
+        } else if (c == '"' && !esc) {
+            in_string = !in_string;
+            expected[nexpected++] = i;
+        } else if (!in_string && c != '"' && strchr("{}[]:,", c) != NULL) {
+            expected[nexpected++] = i;
+        }
+    }
+
+    /* resuming with any room left gives the same result */
+    for (size_t max = SCAN_JSON_BLOCK; max <= sizeof(data); max += 61) {
+        scan_json_state_t state = { 0 };
+        size_t n = 0;
+        while (state.pos < sizeof(data)) {
+            n += scan_json(data, sizeof(data), &state, offsets + n, max);
+        }
+        assert(n == nexpected);
+        assert(memcmp(offsets, expected, n * sizeof(size_t)) == 0);
+    }
+}
+
+void test_scan(void) {
+    printf("Separator scan kernel: %s\n", scan_kernel_name());
+
+    test_scan_separators_matches_scalar();
+    test_scan_separators_max();
+    test_scan_separators_str_matches_scalar();
+    test_scan_find();
+    test_scan_json_matches_scalar();
+    test_scan_count_items();
+}
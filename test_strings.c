@@ -58,8 +58,36 @@ void test_strreplall_nooccurs(void) {
     free((void*)output);
 }
 
+void test_strnreplall_binary(void) {
+    const char src[] = "a\0{}\0b{}";
+    const char v[] = "\0x";
+    const char expected[] = "a\0\0x\0b\0x";
+    size_t len = 0;
+
+    const char *output = strnreplall(src, sizeof(src) - 1, "{}", 2, v, sizeof(v) - 1, &len);
+    assert(len == sizeof(expected) - 1);
+    assert(memcmp(output, expected, len) == 0);
+
+    free((void*)output);
+}
+
+void test_strnfind(void) {
+    const char data[] = "ab{}c\0{}d";
+    size_t len = sizeof(data) - 1;
+
+    assert(strnfind(data, len, "{}", 2) == data + 2);
+    assert(strnfind(data + 3, len - 3, "{}", 2) == data + 6);
+    assert(strnfind(data, len, "\0{", 2) == data + 5);
+    assert(strnfind(data, len, "}d", 2) == data + 7);
+    assert(strnfind(data, len, "{}e", 3) == NULL);
+    assert(strnfind(data, 3, "{}", 2) == NULL);
+    assert(strnfind(data, len, "", 0) == NULL);
+}
+
 void test_strings(void) {
 
     test_strreplall();
     test_strreplall_nooccurs();
+    test_strnreplall_binary();
+    test_strnfind();
 }
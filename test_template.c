@@ -0,0 +1,293 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: test_template.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_template.h"
+#include "template.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Renders src for item, as compiled with opts, and checks the result against expected.
+ */
+static void _assert_renders_opts(const char *src, const char *replstr, const template_opts_t *opts,
+                                 const char *item, const char *expected) {
+    template_t t;
+    assert(template_compile(&t, src, strlen(src), replstr, strlen(replstr), opts) == 0);
+
+    template_ctx_t ctx;
+    template_ctx_init(&ctx);
+    template_ctx_set(&ctx, item, strlen(item));
+
+    char out[128];
+    size_t len;
+    assert(template_bind(&t, &ctx, &len) == 0);
+    assert(len == strlen(expected));
+    size_t n = template_render(&t, &ctx, out);
+    assert(n == strlen(expected));
+    assert(memcmp(out, expected, n) == 0);
+
+    template_ctx_free(&ctx);
+    template_free(&t);
+}
+
+static void _assert_renders(const char *src, const char *replstr, const char *item, const char *expected) {
+    _assert_renders_opts(src, replstr, NULL, item, expected);
+}
+
+static void _assert_renders_fields(const char *src, const char *delim, const char *item, const char *expected) {
+    template_opts_t opts = { .placeholders = 1, .delim = delim, .delim_len = strlen(delim) };
+    _assert_renders_opts(src, "{}", &opts, item, expected);
+}
+
+void test_template_segments(void) {
+    template_t t;
+    const char *src = "<{}>, {}{}";
+    assert(template_compile(&t, src, strlen(src), "{}", 2, NULL) == 0);
+
+    /* empty literals between adjacent slots are dropped */
+    assert(t.nsegs == 5);
+    assert(t.nslots == 3);
+    assert(t.literal_len == 4);
+    assert(t.segs[0].kind == TEMPLATE_LITERAL && t.segs[0].len == 1 && t.segs[0].data == src);
+    assert(t.segs[1].kind == TEMPLATE_ITEM);
+    assert(t.segs[2].kind == TEMPLATE_LITERAL && t.segs[2].len == 3);
+    assert(t.segs[3].kind == TEMPLATE_ITEM);
+    assert(t.segs[4].kind == TEMPLATE_ITEM);
+
+    template_free(&t);
+    assert(t.segs == NULL && t.nsegs == 0);
+}
+
+void test_template_render(void) {
+    _assert_renders("Hello {}!", "{}", "World", "Hello World!");
+    _assert_renders("{}", "{}", "item", "item");
+    _assert_renders("{}{}", "{}", "ab", "abab");
+    _assert_renders("no slots", "{}", "item", "no slots");
+    _assert_renders("", "{}", "item", "");
+    _assert_renders("@@@@@", "@@", "x", "xx@");
+    _assert_renders("[{}]", "{}", "", "[]");
+}
+
+void test_template_binary(void) {
+    /* templates and items may hold NULs */
+    const char src[] = "a\0@\0b";
+    template_t t;
+    assert(template_compile(&t, src, sizeof(src) - 1, "@", 1, NULL) == 0);
+
+    template_ctx_t ctx;
+    template_ctx_init(&ctx);
+    template_ctx_set(&ctx, "x\0y", 3);
+
+    char out[16];
+    size_t len;
+    assert(template_bind(&t, &ctx, &len) == 0 && len == 7);
+    size_t n = template_render(&t, &ctx, out);
+    assert(n == 7);
+    assert(memcmp(out, "a\0x\0y\0b", 7) == 0);
+
+    template_ctx_free(&ctx);
+    template_free(&t);
+}
+
+void test_template_fields(void) {
+    template_t t;
+    template_opts_t opts = { .placeholders = 1, .delim = "\t", .delim_len = 1 };
+    const char *src = "{2}={1} {0}";
+    assert(template_compile(&t, src, strlen(src), "{}", 2, &opts) == 0);
+    assert(t.nslots == 3 && t.max_field == 2);
+    assert(t.segs[0].kind == TEMPLATE_FIELD && t.segs[0].field == 2);
+    assert(t.segs[4].kind == TEMPLATE_ITEM);
+    template_free(&t);
+
+    _assert_renders_fields("{2}={1}", "\t", "a\tb\tc", "b=a");
+    _assert_renders_fields("{3}", ",", "a,b,c", "c");
+    _assert_renders_fields("[{0}|{}]", ",", "a,b", "[a,b|a,b]");
+
+    /* missing fields render empty */
+    _assert_renders_fields("[{4}]", ",", "a,b,c", "[]");
+    _assert_renders_fields("[{2}]", ",", "abc", "[]");
+    _assert_renders_fields("[{1}{2}]", ",", "", "[]");
+    _assert_renders_fields("[{2}]", ",", "a,", "[]");
+
+    /* multi-byte delimiters */
+    _assert_renders_fields("{2}-{3}", "::", "a::b:c::d", "b:c-d");
+
+    /* braces that are not placeholders stay as they are */
+    _assert_renders_fields("{x} {1 {} {", ",", "a,b", "{x} {1 a,b {");
+    _assert_renders_fields("{{1}}", ",", "a,b", "{a}");
+
+    /* without placeholders only replstr is recognized */
+    _assert_renders("{1}@", "@", "a\tb", "{1}a\tb");
+}
+
+void test_template_literal_braces(void) {
+    /* a JSON value: braces that are not placeholders, then the item at the end */
+    const char unit[] = "{\"a\":1},";
+    size_t count = 200000;
+    size_t len = count * (sizeof(unit) - 1) + 2;
+    char *src = malloc(len);
+    assert(src != NULL);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(src + i * (sizeof(unit) - 1), unit, sizeof(unit) - 1);
+    }
+    memcpy(src + len - 2, "{}", 2);
+
+    /* replstr is looked for once per occurrence, not once per brace: this used to take minutes */
+    template_t t;
+    template_opts_t opts = { .placeholders = 1, .delim = "\t", .delim_len = 1 };
+    assert(template_compile(&t, src, len, "{}", 2, &opts) == 0);
+
+    assert(t.nsegs == 2 && t.nslots == 1);
+    assert(t.segs[0].kind == TEMPLATE_LITERAL && t.segs[0].len == len - 2);
+    assert(t.segs[1].kind == TEMPLATE_ITEM);
+
+    template_ctx_t ctx;
+    template_ctx_init(&ctx);
+    template_ctx_set(&ctx, "xy", 2);
+
+    size_t rendered;
+    assert(template_bind(&t, &ctx, &rendered) == 0);
+    assert(rendered == len);
+    char *out = malloc(rendered);
+    assert(out != NULL);
+    assert(template_render(&t, &ctx, out) == len);
+    assert(memcmp(out, src, len - 2) == 0);
+    assert(memcmp(out + len - 2, "xy", 2) == 0);
+
+    free(out);
+    template_ctx_free(&ctx);
+    template_free(&t);
+    free(src);
+}
+
+void test_template_many_fields(void) {
+    /* more fields than a single scan collects */
+    char item[512];
+    char *p = item;
+    for (int i = 1; i <= 150; i++) {
+        p += sprintf(p, "%d,", i);
+    }
+    *--p = '\0';
+
+    _assert_renders_fields("{1} {64} {65} {66} {150} {151}", ",", item, "1 64 65 66 150 ");
+}
+
+void test_template_json(void) {
+    template_t t;
+    template_opts_t opts = { .placeholders = 1, .delim = "\t", .delim_len = 1 };
+    const char *src = "{.a.b}:{.c[1]}";
+    assert(template_compile(&t, src, strlen(src), "{}", 2, &opts) == 0);
+    assert(t.nslots == 2 && t.max_field == 0);
+    assert(t.segs[0].kind == TEMPLATE_JSON && t.segs[0].len == 4 && memcmp(t.segs[0].data, ".a.b", 4) == 0);
+    template_free(&t);
+
+    const char *item = "{\"a\": {\"b\": \"x\"}, \"c\": [1, 2.5]}";
+    _assert_renders_fields("{.a.b}:{.c[1]}", "\t", item, "x:2.5");
+    _assert_renders_fields("{.c}", "\t", item, "[1, 2.5]");
+    _assert_renders_fields("[{.d}]", "\t", item, "[]");
+    _assert_renders_fields("[{.a.b}]", "\t", "not json", "[]");
+
+    /* escaped strings are decoded, possibly several of them */
+    _assert_renders_fields("{.s}|{.t}|{.a}|{.s}", "\t", "{\"s\": \"q\\\"q\", \"t\": \"\\u00e9\", \"a\": \"\\n\"}",
+                           "q\"q|\xc3\xa9|\n|q\"q");
+
+    /* braces that only look like paths */
+    _assert_renders_fields("{.} {.a {..a}", "\t", item, "{.} {.a {..a}");
+}
+
+void test_template_transforms(void) {
+    template_t t;
+    template_opts_t opts = { .placeholders = 1, .delim = ",", .delim_len = 1 };
+    const char *src = "{upper}{2|trim|lower}{.a|len}";
+    assert(template_compile(&t, src, strlen(src), "{}", 2, &opts) == 0);
+    assert(t.nsegs == 3 && t.nfns == 4);
+    assert(t.segs[0].kind == TEMPLATE_ITEM && t.segs[0].nfns == 1 && t.fns[0].kind == TRANSFORM_UPPER);
+    assert(t.segs[1].kind == TEMPLATE_FIELD && t.segs[1].fn == 1 && t.segs[1].nfns == 2);
+    assert(t.segs[2].kind == TEMPLATE_JSON && t.segs[2].fn == 3 && t.fns[3].kind == TRANSFORM_LEN);
+    template_free(&t);
+
+    _assert_renders_fields("<{upper}>", ",", "abc", "<ABC>");
+    _assert_renders_fields("{0|lower} {1|upper} {2|len}", ",", "Ab,cd", "ab,cd AB 2");
+    _assert_renders_fields("{basename|substr:0:3|upper}", ",", "/tmp/file.txt", "FIL");
+    _assert_renders_fields("{1|trim|urlencode}", ",", " a b ,c", "a%20b");
+    _assert_renders_fields("[{3|upper}] [{3|len}]", ",", "a,b", "[] [0]");
+
+    /* selections of transformed values, which live in the scratch */
+    _assert_renders_fields("{upper|substr:1:3}|{lower|trim}|{urlencode|ext}", ",", " a.B ",
+                           "A.|a.b|B%20");
+    _assert_renders_fields("{.s|upper|substr:1}{.s|dirname}", ",", "{\"s\": \"x\\/y\"}", "/Yx");
+
+    /* unknown transforms and misplaced pipes are literal text */
+    _assert_renders_fields("{nope} {1|nope} {1|} {|upper} {upper|} {1upper}", ",", "a",
+                           "{nope} {1|nope} {1|} {|upper} {upper|} {1upper}");
+}
+
+void test_template_ctx_reuse(void) {
+    template_opts_t comma = { .placeholders = 1, .delim = ",", .delim_len = 1 };
+    template_opts_t colon = { .placeholders = 1, .delim = ":", .delim_len = 1 };
+    template_t first, second;
+    assert(template_compile(&first, "{1}", 3, "{}", 2, &comma) == 0);
+    assert(template_compile(&second, "{2}", 3, "{}", 2, &colon) == 0);
+
+    template_ctx_t ctx;
+    template_ctx_init(&ctx);
+    char out[16];
+    size_t len;
+
+    /* templates splitting the same item on different delimiters */
+    template_ctx_set(&ctx, "a:b,c:d", 7);
+    assert(template_bind(&first, &ctx, &len) == 0 && len == 3);
+    assert(template_render(&first, &ctx, out) == 3 && memcmp(out, "a:b", 3) == 0);
+    assert(template_bind(&second, &ctx, &len) == 0 && len == 3);
+    assert(template_render(&second, &ctx, out) == 3 && memcmp(out, "b,c", 3) == 0);
+
+    /* the next item is split again */
+    template_ctx_set(&ctx, "x,y", 3);
+    assert(template_bind(&first, &ctx, &len) == 0 && len == 1);
+    assert(template_render(&first, &ctx, out) == 1 && out[0] == 'x');
+
+    template_ctx_free(&ctx);
+    template_free(&first);
+    template_free(&second);
+}
+
+void test_template(void) {
+    test_template_segments();
+    test_template_render();
+    test_template_binary();
+    test_template_fields();
+    test_template_literal_braces();
+    test_template_many_fields();
+    test_template_json();
+    test_template_transforms();
+    test_template_ctx_reuse();
+}
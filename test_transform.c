@@ -0,0 +1,145 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: test_transform.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_transform.h"
+#include "transform.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Parses the transform at the beginning of spec, which must be followed by },
+ * applies it to input and checks the result against expected.
+ */
+static void _assert_transforms(const char *spec, const char *input, const char *expected) {
+    transform_t t;
+    assert(transform_parse(spec, strlen(spec), &t) == strlen(spec) - 1);
+
+    char dst[256];
+    size_t max = transform_max_len(&t, strlen(input));
+    assert(max <= sizeof(dst));
+
+    const char *out;
+    size_t n = transform_apply(&t, input, strlen(input), dst, &out);
+    assert(n == strlen(expected));
+    assert(memcmp(out, expected, n) == 0);
+
+    if (out == dst) {
+        assert(n <= max);
+    } else if (n > 0) {
+        /* selections point into their input */
+        assert(out >= input && out + n <= input + strlen(input));
+    }
+}
+
+void test_transform_parse(void) {
+    transform_t t;
+    assert(transform_parse("upper}", 6, &t) == 5 && t.kind == TRANSFORM_UPPER);
+    assert(transform_parse("trim|upper}", 11, &t) == 4 && t.kind == TRANSFORM_TRIM);
+    assert(transform_parse("substr:2:5}", 11, &t) == 10 && t.kind == TRANSFORM_SUBSTR);
+    assert(t.from == 2 && t.to == 5);
+    assert(transform_parse("substr:3}", 9, &t) == 8 && t.from == 3 && t.to == (size_t)-1);
+    assert(transform_parse("substr::4}", 10, &t) == 9 && t.from == 0 && t.to == 4);
+
+    assert(transform_parse("upper", 5, &t) == 0);
+    assert(transform_parse("uppercase}", 10, &t) == 0);
+    assert(transform_parse("Upper}", 6, &t) == 0);
+    assert(transform_parse("substr}", 7, &t) == 0);
+    assert(transform_parse("substr:}", 8, &t) == 0);
+    assert(transform_parse("substr:1:}", 10, &t) == 0);
+    assert(transform_parse("upper:1}", 8, &t) == 0);
+    assert(transform_parse("}", 1, &t) == 0);
+}
+
+void test_transform_case(void) {
+    _assert_transforms("upper}", "Hello, World! 123 @[`{", "HELLO, WORLD! 123 @[`{");
+    _assert_transforms("lower}", "Hello, World! 123 @[`{", "hello, world! 123 @[`{");
+    _assert_transforms("upper}", "", "");
+
+    /* bytes past ASCII are left as they are */
+    _assert_transforms("upper}", "caf\xc3\xa9", "CAF\xc3\xa9");
+
+    /* long enough for the vectorized loop and its tail */
+    char in[101], up[101];
+    for (int i = 0; i < 100; i++) {
+        in[i] = (char)('a' + i % 26);
+        up[i] = (char)('A' + i % 26);
+    }
+    in[100] = up[100] = '\0';
+    _assert_transforms("upper}", in, up);
+}
+
+void test_transform_selections(void) {
+    _assert_transforms("trim}", " \t a b \r\n", "a b");
+    _assert_transforms("trim}", "   ", "");
+
+    _assert_transforms("basename}", "/usr/lib/libc.so", "libc.so");
+    _assert_transforms("basename}", "/usr/lib/", "lib");
+    _assert_transforms("basename}", "file", "file");
+    _assert_transforms("basename}", "/", "/");
+    _assert_transforms("basename}", "", "");
+
+    _assert_transforms("dirname}", "/usr/lib/libc.so", "/usr/lib");
+    _assert_transforms("dirname}", "/usr/lib/", "/usr");
+    _assert_transforms("dirname}", "a//b", "a");
+    _assert_transforms("dirname}", "/usr", "/");
+    _assert_transforms("dirname}", "file", ".");
+    _assert_transforms("dirname}", "/", "/");
+
+    _assert_transforms("ext}", "archive.tar.gz", "gz");
+    _assert_transforms("ext}", "/a.b/file", "");
+    _assert_transforms("ext}", ".bashrc", "");
+    _assert_transforms("ext}", "dir/x.c/", "c");
+
+    _assert_transforms("substr:1:3}", "abcdef", "bc");
+    _assert_transforms("substr:4}", "abcdef", "ef");
+    _assert_transforms("substr:2:100}", "abc", "c");
+    _assert_transforms("substr:5:9}", "abc", "");
+    _assert_transforms("substr:2:1}", "abc", "");
+}
+
+void test_transform_encodings(void) {
+    _assert_transforms("len}", "", "0");
+    _assert_transforms("len}", "hello", "5");
+
+    /* XXH64 with seed 0, as the reference implementation computes it */
+    _assert_transforms("xxhash}", "", "ef46db3751d8e999");
+    _assert_transforms("xxhash}", "a", "d24ec4f1a98c6e5b");
+
+    _assert_transforms("urlencode}", "a b&c=d/é~-._", "a%20b%26c%3Dd%2F%C3%A9~-._");
+    _assert_transforms("urlencode}", "", "");
+}
+
+void test_transform(void) {
+    test_transform_parse();
+    test_transform_case();
+    test_transform_selections();
+    test_transform_encodings();
+}
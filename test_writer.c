@@ -0,0 +1,184 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: test_writer.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_writer.h"
+#include "writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Returns how many bytes can be read from fd without blocking.
+ */
+static size_t _pending(int fd, char *out, size_t max) {
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    ssize_t n = read(fd, out, max);
+    fcntl(fd, F_SETFL, flags);
+    return n > 0 ? (size_t)n : 0;
+}
+
+void test_writer_block_policy(void) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    writer_t w;
+    assert(writer_init(&w, fds[1], 8, WRITER_FLUSH_BLOCK, 0) == BUFFER_SUCCESS);
+
+    char out[32];
+    assert(writer_write(&w, "abc", 3) == BUFFER_SUCCESS);
+    assert(writer_end_record(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 0);
+
+    /* filling the block writes it out */
+    assert(writer_write(&w, "defghi", 6) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 8);
+    assert(memcmp(out, "abcdefgh", 8) == 0);
+
+    assert(writer_flush(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 1);
+    assert(out[0] == 'i');
+
+    writer_free(&w);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_writer_record_policy(void) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    writer_t w;
+    assert(writer_init(&w, fds[1], 64, WRITER_FLUSH_RECORD, 0) == BUFFER_SUCCESS);
+
+    char out[32];
+    assert(writer_write(&w, "abc", 3) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 0);
+    assert(writer_end_record(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 3);
+
+    writer_free(&w);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_writer_time_policy(void) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    /* an interval no test run gets close to: time only passes by moving the last flush back */
+    writer_t w;
+    assert(writer_init(&w, fds[1], 64, WRITER_FLUSH_TIME, 60 * 1000) == BUFFER_SUCCESS);
+
+    char out[32];
+    assert(writer_write(&w, "abc", 3) == BUFFER_SUCCESS);
+    assert(writer_end_record(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 0);
+
+    /* records are written out once they have waited for the interval */
+    w.last_flush.tv_sec -= 60;
+    assert(writer_write(&w, "def", 3) == BUFFER_SUCCESS);
+    assert(writer_end_record(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 6);
+
+    /* which starts the interval over */
+    assert(writer_write(&w, "ghi", 3) == BUFFER_SUCCESS);
+    assert(writer_end_record(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 0);
+
+    /* or as soon as the input goes quiet */
+    assert(writer_idle(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 3);
+
+    writer_free(&w);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_writer_large_writes(void) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    writer_t w;
+    assert(writer_init(&w, fds[1], 8, WRITER_FLUSH_BLOCK, 0) == BUFFER_SUCCESS);
+
+    /* larger than the buffer: written out at once, after what is buffered */
+    char out[64];
+    assert(writer_write(&w, "ab", 2) == BUFFER_SUCCESS);
+    assert(writer_write(&w, "0123456789", 10) == BUFFER_SUCCESS);
+    assert(w.buf.pos == 0);
+    assert(_pending(fds[0], out, sizeof(out)) == 12);
+    assert(memcmp(out, "ab0123456789", 12) == 0);
+
+    writer_free(&w);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_writer_frame_once(void) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    writer_t w;
+    assert(writer_init(&w, fds[1], 64, WRITER_FLUSH_RECORD, 0) == BUFFER_SUCCESS);
+    w.frame = BUFFER_FRAME_VARINT;
+    w.prefix = "1\t";
+    w.prefix_len = 2;
+
+    /* a record started twice, e.g. after a failed kernel copy, still has a single header */
+    char out[32];
+    assert(writer_frame(&w, 3) == BUFFER_SUCCESS);
+    assert(writer_frame(&w, 3) == BUFFER_SUCCESS);
+    assert(writer_write(&w, "abc", 3) == BUFFER_SUCCESS);
+    assert(writer_end_record(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 6);
+    assert(memcmp(out, "\0051\tabc", 6) == 0);
+
+    /* the next record gets its own */
+    assert(writer_frame(&w, 2) == BUFFER_SUCCESS);
+    assert(writer_write(&w, "de", 2) == BUFFER_SUCCESS);
+    assert(writer_end_record(&w) == BUFFER_SUCCESS);
+    assert(_pending(fds[0], out, sizeof(out)) == 3);
+    assert(memcmp(out, "\002de", 3) == 0);
+
+    writer_free(&w);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_writer(void) {
+    test_writer_block_policy();
+    test_writer_record_policy();
+    test_writer_time_policy();
+    test_writer_large_writes();
+    test_writer_frame_once();
+}
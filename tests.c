@@ -34,6 +34,13 @@
 
 #include "test_map.h"
 #include "test_strings.h"
+#include "test_scan.h"
+#include "test_buffers.h"
+#include "test_hash.h"
+#include "test_writer.h"
+#include "test_template.h"
+#include "test_json.h"
+#include "test_transform.h"
 
 void test_example(void) {
     // Test case example
@@ -53,6 +60,13 @@ int main(void) {
 
     test_map();
     test_strings();
+    test_scan();
+    test_buffers();
+    test_hash();
+    test_writer();
+    test_template();
+    test_json();
+    test_transform();
     
     printf("\x1b[32mAll tests PASSED\x1b[0m\n");
     return 0;
@@ -0,0 +1,278 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: transform.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "transform.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/* a 64-bit length in decimal, and a 64-bit hash in hex */
+#define TRANSFORM_LEN_MAX 20
+#define TRANSFORM_XXHASH_LEN 16
+
+typedef struct {
+    const char *name;
+    transform_kind_t kind;
+} transform_name_t;
+
+static const transform_name_t transform_names[] = {
+    { "upper", TRANSFORM_UPPER },
+    { "lower", TRANSFORM_LOWER },
+    { "trim", TRANSFORM_TRIM },
+    { "basename", TRANSFORM_BASENAME },
+    { "dirname", TRANSFORM_DIRNAME },
+    { "ext", TRANSFORM_EXT },
+    { "len", TRANSFORM_LEN },
+    { "substr", TRANSFORM_SUBSTR },
+    { "xxhash", TRANSFORM_XXHASH },
+    { "urlencode", TRANSFORM_URLENCODE },
+};
+
+/*
+ * Parses the decimal number at the beginning of the len bytes of src into n.
+ * Returns the number of digits parsed.
+ */
+static size_t transform_parse_num(const char *src, size_t len, size_t *n) {
+    size_t i = 0;
+    *n = 0;
+    while (i < len && src[i] >= '0' && src[i] <= '9' && *n < ((size_t)-1 - 9) / 10) {
+        *n = *n * 10 + (size_t)(src[i++] - '0');
+    }
+    return i;
+}
+
+size_t transform_parse(const char *src, size_t len, transform_t *t) {
+    size_t i = 0;
+    while (i < len && src[i] >= 'a' && src[i] <= 'z') {
+        i++;
+    }
+
+    size_t k = 0;
+    size_t count = sizeof(transform_names) / sizeof(transform_names[0]);
+    while (k < count && (strlen(transform_names[k].name) != i || memcmp(transform_names[k].name, src, i) != 0)) {
+        k++;
+    }
+    if (i == 0 || k == count) {
+        return 0;
+    }
+
+    *t = (transform_t){ .kind = transform_names[k].kind, .from = 0, .to = (size_t)-1 };
+    if (t->kind == TRANSFORM_SUBSTR) {
+        /* substr:<from>[:<to>] */
+        if (i == len || src[i] != ':') {
+            return 0;
+        }
+        i++;
+        size_t n = transform_parse_num(src + i, len - i, &t->from);
+        i += n;
+        if (i < len && src[i] == ':') {
+            i++;
+            n = transform_parse_num(src + i, len - i, &t->to);
+            if (n == 0) {
+                return 0;
+            }
+            i += n;
+        } else if (n == 0) {
+            return 0;
+        }
+    }
+
+    if (i == len || (src[i] != '|' && src[i] != '}')) {
+        return 0;
+    }
+    return i;
+}
+
+size_t transform_max_len(const transform_t *t, size_t len) {
+    switch (t->kind) {
+        case TRANSFORM_UPPER:
+        case TRANSFORM_LOWER:
+            return len;
+        case TRANSFORM_LEN:
+            return TRANSFORM_LEN_MAX;
+        case TRANSFORM_XXHASH:
+            return TRANSFORM_XXHASH_LEN;
+        case TRANSFORM_DIRNAME:
+            /* . or / for paths with a single component */
+            return 1;
+        case TRANSFORM_URLENCODE:
+            return len * 3;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * ASCII case conversion with no branches: a plain byte loop the compiler vectorizes.
+ * Flipping bit 5 of the letters in [first, first + 26) switches their case.
+ */
+static void transform_case(const char *src, size_t len, char *dst, unsigned char first) {
+    const unsigned char *s = (const unsigned char *)src;
+    unsigned char *d = (unsigned char *)dst;
+    for (size_t i = 0; i < len; i++) {
+        d[i] = s[i] ^ (((unsigned char)(s[i] - first) < 26) << 5);
+    }
+}
+
+static inline int transform_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/* bytes left as they are by urlencode: the unreserved characters of RFC 3986 */
+static inline int transform_unreserved(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+static size_t transform_urlencode(const char *src, size_t len, char *dst) {
+    static const char hex[] = "0123456789ABCDEF";
+    char *p = dst;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)src[i];
+        if (transform_unreserved(c)) {
+            *p++ = (char)c;
+        } else {
+            *p++ = '%';
+            *p++ = hex[c >> 4];
+            *p++ = hex[c & 0xF];
+        }
+    }
+    return p - dst;
+}
+
+/*
+ * Returns the length of the path in the len bytes of src without its trailing slashes,
+ * keeping a single one for the root.
+ */
+static size_t transform_strip_slashes(const char *src, size_t len) {
+    while (len > 1 && src[len - 1] == '/') {
+        len--;
+    }
+    return len;
+}
+
+/*
+ * Returns the offset of the last component of the len bytes of path, as stripped already.
+ */
+static size_t transform_basename_at(const char *src, size_t len) {
+    if (len == 1 && src[0] == '/') {
+        return 0;
+    }
+    size_t i = len;
+    while (i > 0 && src[i - 1] != '/') {
+        i--;
+    }
+    return i;
+}
+
+size_t transform_apply(const transform_t *t, const char *src, size_t len, char *dst, const char **out) {
+    size_t start, end;
+    switch (t->kind) {
+        case TRANSFORM_UPPER:
+        case TRANSFORM_LOWER:
+            transform_case(src, len, dst, t->kind == TRANSFORM_UPPER ? 'a' : 'A');
+            *out = dst;
+            return len;
+
+        case TRANSFORM_TRIM:
+            start = 0;
+            end = len;
+            while (start < end && transform_space(src[start])) {
+                start++;
+            }
+            while (end > start && transform_space(src[end - 1])) {
+                end--;
+            }
+            *out = src + start;
+            return end - start;
+
+        case TRANSFORM_BASENAME:
+            /* as basename(1): /usr/lib/ is lib */
+            end = transform_strip_slashes(src, len);
+            start = transform_basename_at(src, end);
+            *out = src + start;
+            return end - start;
+
+        case TRANSFORM_DIRNAME:
+            /* as dirname(1): /usr/lib/ is /usr, lib is . */
+            end = transform_strip_slashes(src, len);
+            start = transform_basename_at(src, end);
+            if (start == 0) {
+                dst[0] = end == 1 && src[0] == '/' ? '/' : '.';
+                *out = dst;
+                return 1;
+            }
+            *out = src;
+            return transform_strip_slashes(src, start);
+
+        case TRANSFORM_EXT:
+            /* without the dot, empty for names without one or starting with it */
+            end = transform_strip_slashes(src, len);
+            start = transform_basename_at(src, end);
+            for (size_t i = end; i > start + 1; i--) {
+                if (src[i - 1] == '.') {
+                    *out = src + i;
+                    return end - i;
+                }
+            }
+            *out = src + end;
+            return 0;
+
+        case TRANSFORM_LEN: {
+            char num[TRANSFORM_LEN_MAX + 1];
+            size_t n = (size_t)snprintf(num, sizeof(num), "%zu", len);
+            memcpy(dst, num, n);
+            *out = dst;
+            return n;
+        }
+
+        case TRANSFORM_SUBSTR:
+            start = t->from < len ? t->from : len;
+            end = t->to < len ? t->to : len;
+            *out = src + start;
+            return end > start ? end - start : 0;
+
+        case TRANSFORM_XXHASH: {
+            char hash[TRANSFORM_XXHASH_LEN + 1];
+            snprintf(hash, sizeof(hash), "%016" PRIx64, hash_xxh64(src, len, 0));
+            memcpy(dst, hash, TRANSFORM_XXHASH_LEN);
+            *out = dst;
+            return TRANSFORM_XXHASH_LEN;
+        }
+
+        case TRANSFORM_URLENCODE:
+            *out = dst;
+            return transform_urlencode(src, len, dst);
+    }
+
+    *out = src;
+    return len;
+}
@@ -0,0 +1,76 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: transform.h
+ * Description: functions applied to the values of template placeholders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stddef.h>
+
+typedef enum {
+    TRANSFORM_UPPER = 0,
+    TRANSFORM_LOWER,
+    TRANSFORM_TRIM,
+    TRANSFORM_BASENAME,
+    TRANSFORM_DIRNAME,
+    TRANSFORM_EXT,
+    TRANSFORM_LEN,
+    TRANSFORM_SUBSTR,
+    TRANSFORM_XXHASH,
+    TRANSFORM_URLENCODE
+} transform_kind_t;
+
+typedef struct {
+    transform_kind_t kind;
+
+    /* byte range [from, to) kept by TRANSFORM_SUBSTR */
+    size_t from;
+    size_t to;
+} transform_t;
+
+/*
+ * Parses the transform named at the beginning of the len bytes of src into t:
+ * upper, lower, trim, basename, dirname, ext, len, substr:<from>[:<to>], xxhash or urlencode.
+ * Returns the length of the transform, or 0 if src does not start with one followed by | or }.
+ */
+size_t transform_parse(const char *src, size_t len, transform_t *t);
+
+/*
+ * Returns how many bytes t may write to dst for an input of len bytes:
+ * 0 for transforms only ever selecting a part of their input.
+ */
+size_t transform_max_len(const transform_t *t, size_t len);
+
+/*
+ * Applies t to the len bytes of src, writing into dst if needed (see transform_max_len).
+ * Points out to the result, either within src or at dst, and returns its length.
+ */
+size_t transform_apply(const transform_t *t, const char *src, size_t len, char *dst, const char **out);
+
+#endif // TRANSFORM_H
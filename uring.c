@@ -0,0 +1,293 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: uring.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* syscall(2) is not part of POSIX */
+#define _DEFAULT_SOURCE
+
+#include "uring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #define URING_SUPPORTED 1
+    #endif
+#endif
+
+#ifdef URING_SUPPORTED
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct uring {
+    int fd;
+
+    /* submission queue */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned to_submit;
+
+    /* completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+uring_t *uring_create(unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    /* reads and writes at the current file position need IORING_OP_READ/WRITE (Linux 5.6) */
+    if ((p.features & IORING_FEAT_RW_CUR_POS) == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    uring_t *ring = calloc(1, sizeof(uring_t));
+    if (ring == NULL) {
+        close(fd);
+        return NULL;
+    }
+    ring->fd = fd;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        uring_destroy(ring);
+        return NULL;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            uring_destroy(ring);
+            return NULL;
+        }
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_destroy(ring);
+        return NULL;
+    }
+
+    char *sq = ring->sq_ring;
+    ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+
+    char *cq = ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    return ring;
+}
+
+void uring_destroy(uring_t *ring) {
+    if (ring == NULL) {
+        return;
+    }
+
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+
+    close(ring->fd);
+    free(ring);
+}
+
+int uring_submit(uring_t *ring) {
+    while (ring->to_submit > 0) {
+        int r = uring_enter(ring->fd, ring->to_submit, 0, 0);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ring->to_submit -= r;
+    }
+    return 0;
+}
+
+static struct io_uring_sqe *uring_get_sqe(uring_t *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail;
+
+    if (tail - head >= ring->sq_entries) {
+        /* the submission queue is full: hand what is queued to the kernel first */
+        if (uring_submit(ring) != 0) {
+            return NULL;
+        }
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    unsigned idx = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[idx] = idx;
+
+    return sqe;
+}
+
+static int uring_queue(uring_t *ring, int op, int fd, const void *buf, size_t len, int64_t offset, uint64_t tag) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    if (sqe == NULL) {
+        return -1;
+    }
+
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->off = (uint64_t)offset;
+    sqe->user_data = tag;
+
+    /* make the entry visible to the kernel only once it is filled in */
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+
+    return 0;
+}
+
+int uring_read(uring_t *ring, int fd, void *buf, size_t len, int64_t offset, uint64_t tag) {
+    return uring_queue(ring, IORING_OP_READ, fd, buf, len, offset, tag);
+}
+
+int uring_write(uring_t *ring, int fd, const void *buf, size_t len, int64_t offset, uint64_t tag) {
+    return uring_queue(ring, IORING_OP_WRITE, fd, buf, len, offset, tag);
+}
+
+int uring_wait(uring_t *ring, uint64_t *tag, int *res) {
+    for (;;) {
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        if (head != tail) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+            *tag = cqe->user_data;
+            *res = cqe->res;
+            __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+            return 0;
+        }
+
+        int r = uring_enter(ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ring->to_submit -= r;
+    }
+}
+
+#else
+
+uring_t *uring_create(unsigned entries) {
+    (void)entries;
+    return NULL;
+}
+
+void uring_destroy(uring_t *ring) {
+    (void)ring;
+}
+
+int uring_read(uring_t *ring, int fd, void *buf, size_t len, int64_t offset, uint64_t tag) {
+    (void)ring; (void)fd; (void)buf; (void)len; (void)offset; (void)tag;
+    return -1;
+}
+
+int uring_write(uring_t *ring, int fd, const void *buf, size_t len, int64_t offset, uint64_t tag) {
+    (void)ring; (void)fd; (void)buf; (void)len; (void)offset; (void)tag;
+    return -1;
+}
+
+int uring_submit(uring_t *ring) {
+    (void)ring;
+    return -1;
+}
+
+int uring_wait(uring_t *ring, uint64_t *tag, int *res) {
+    (void)ring; (void)tag; (void)res;
+    return -1;
+}
+
+#endif // URING_SUPPORTED
@@ -0,0 +1,70 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: uring.h
+ * Description: minimal io_uring interface, probed at runtime
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* offset meaning "the current file position" for reads and writes */
+#define URING_CUR_POS ((int64_t)-1)
+
+typedef struct uring uring_t;
+
+/*
+ * Sets up an io_uring instance with room for entries submissions.
+ * Returns NULL if io_uring is not supported by the build or by the running kernel
+ * (or it has been disabled): callers are expected to fall back to regular syscalls.
+ */
+uring_t *uring_create(unsigned entries);
+void uring_destroy(uring_t *ring);
+
+/*
+ * Queue a read or a write of len bytes at offset on fd.
+ * tag is handed back by uring_wait once the operation completes.
+ * Nothing is sent to the kernel until uring_submit or uring_wait are called.
+ */
+int uring_read(uring_t *ring, int fd, void *buf, size_t len, int64_t offset, uint64_t tag);
+int uring_write(uring_t *ring, int fd, const void *buf, size_t len, int64_t offset, uint64_t tag);
+
+/*
+ * Sends the queued operations to the kernel without waiting for them.
+ */
+int uring_submit(uring_t *ring);
+
+/*
+ * Submits the queued operations and waits for the next completion,
+ * setting tag and res (bytes transferred or -errno) accordingly.
+ * Returns 0 on success, -1 on failure.
+ */
+int uring_wait(uring_t *ring, uint64_t *tag, int *res);
+
+#endif // URING_H
@@ -0,0 +1,144 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: writer.c
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "writer.h"
+
+#include <unistd.h>
+
+static inline long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+int writer_init(writer_t *w, int fd, size_t size, writer_flush_t policy, long interval_ms) {
+    if (policy == WRITER_FLUSH_AUTO) {
+        policy = isatty(fd) ? WRITER_FLUSH_RECORD : WRITER_FLUSH_BLOCK;
+    }
+
+    w->fd = fd;
+    w->policy = policy;
+    w->interval_ms = interval_ms;
+    w->splice_f = 0;
+    w->kcopy_f = 0;
+    w->frame = BUFFER_FRAME_NONE;
+    w->started = 0;
+    w->prefix = NULL;
+    w->prefix_len = 0;
+    w->record = (buffer_t){0};
+    clock_gettime(CLOCK_MONOTONIC, &w->last_flush);
+
+    return buffer_init(&w->buf, size);
+}
+
+void writer_free(writer_t *w) {
+    buffer_free(&w->buf);
+    buffer_free(&w->record);
+}
+
+int writer_write(writer_t *w, const char *data, size_t len) {
+    if (len < w->buf.size || len <= buffer_available(&w->buf)) {
+        return buffer_write(w->fd, &w->buf, data, len);
+    }
+
+    /* not worth copying through the buffer: gather it with what is buffered in a single write */
+    struct iovec iov[2] = {
+        { w->buf.data, w->buf.pos },
+        { (void*)data, len }
+    };
+    int r = buffer_writev(w->fd, iov, 2);
+    buffer_reset(&w->buf);
+    return r;
+}
+
+int writer_frame(writer_t *w, size_t len) {
+    if (w->started) {
+        return BUFFER_SUCCESS;
+    }
+    w->started = 1;
+
+    if (w->frame != BUFFER_FRAME_NONE) {
+        char header[BUFFER_FRAME_MAX_HEADER];
+        size_t n = buffer_frame_header(w->frame, len + w->prefix_len, header);
+        if (n == 0) {
+            fprintf(stderr, "Error: record of %zu bytes too long for the output framing\n", len + w->prefix_len);
+            return BUFFER_FLUSH_ERROR;
+        }
+        if (buffer_write(w->fd, &w->buf, header, n) != BUFFER_SUCCESS) {
+            return BUFFER_FLUSH_ERROR;
+        }
+    }
+
+    if (w->prefix_len == 0) {
+        return BUFFER_SUCCESS;
+    }
+
+    size_t n = w->prefix_len;
+    w->prefix_len = 0;
+    return buffer_write(w->fd, &w->buf, w->prefix, n);
+}
+
+int writer_flush(writer_t *w) {
+    if (w->policy == WRITER_FLUSH_TIME) {
+        clock_gettime(CLOCK_MONOTONIC, &w->last_flush);
+    }
+
+    if (w->buf.pos == 0) {
+        return BUFFER_SUCCESS;
+    }
+
+    int r = buffer_flush(w->fd, &w->buf);
+    buffer_reset(&w->buf);
+    return r;
+}
+
+int writer_end_record(writer_t *w) {
+    w->started = 0;
+
+    switch (w->policy) {
+        case WRITER_FLUSH_RECORD:
+            return writer_flush(w);
+        case WRITER_FLUSH_TIME:
+            if (elapsed_ms(&w->last_flush) >= w->interval_ms) {
+                return writer_flush(w);
+            }
+            return BUFFER_SUCCESS;
+        default:
+            /* the buffer is written out as it fills up */
+            return BUFFER_SUCCESS;
+    }
+}
+
+int writer_idle(void *arg) {
+    writer_t *w = arg;
+    if (w->policy != WRITER_FLUSH_TIME) {
+        return BUFFER_SUCCESS;
+    }
+    return writer_flush(w);
+}
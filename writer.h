@@ -0,0 +1,129 @@
+/*
+ * map - a fast CLI for mapping and transforming input to output.
+ *
+ * Copyright (c) 2025, Alessandro Diaferia < alediaferia at gmail dot com >
+ * 
+ * File: writer.h
+ * Description: buffered output with flush policies
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <time.h>
+
+#include "buffers.h"
+
+typedef enum {
+    /* WRITER_FLUSH_RECORD on terminals, WRITER_FLUSH_BLOCK otherwise */
+    WRITER_FLUSH_AUTO = 0,
+
+    /* write out only when the buffer is full: best throughput */
+    WRITER_FLUSH_BLOCK,
+
+    /* write out after every record */
+    WRITER_FLUSH_RECORD,
+
+    /* write out records once they have been waiting for a given interval */
+    WRITER_FLUSH_TIME
+} writer_flush_t;
+
+/*
+ * Accumulates records in a buffer before writing them to fd,
+ * according to the flush policy.
+ */
+typedef struct {
+    int fd;
+    buffer_t buf;
+
+    writer_flush_t policy;
+    long interval_ms;
+
+    /* when buf was last written out (WRITER_FLUSH_TIME only) */
+    struct timespec last_flush;
+
+    /* set by the caller when data can be spliced to fd directly, once buf has been flushed */
+    int splice_f;
+
+    /* set by the caller when files can be copied to fd by the kernel, once buf has been flushed */
+    int kcopy_f;
+
+    /* set by the caller to prefix each record with its length (see writer_frame) */
+    buffer_frame_t frame;
+
+    /* set once the current record has been started (see writer_frame) */
+    int started;
+
+    /* bytes leading the next record, within its frame (see writer_frame) */
+    const char *prefix;
+    size_t prefix_len;
+
+    /* storage for a prefix built per record, so that it lives as long as w (e.g. --tag) */
+    char prefixbuf[24];
+
+    /* scratch space for framed records whose length is not known upfront */
+    buffer_t record;
+} writer_t;
+
+/*
+ * Initializes w to write to fd through a buffer of size bytes,
+ * which is also the block size of WRITER_FLUSH_BLOCK.
+ * interval_ms is only used by WRITER_FLUSH_TIME.
+ */
+int writer_init(writer_t *w, int fd, size_t size, writer_flush_t policy, long interval_ms);
+void writer_free(writer_t *w);
+
+/*
+ * Appends len bytes of data, writing the buffer out whenever it fills up.
+ * Data larger than the whole buffer is written out along with it, without being copied.
+ */
+int writer_write(writer_t *w, const char *data, size_t len);
+
+/*
+ * Starts a record of len bytes: writes its length prefix, if w is framed,
+ * followed by the pending record prefix, if any, which is then cleared.
+ * len does not include the record prefix. The record itself follows with writer_write.
+ * Does nothing if the record has already been started: a path that gives up
+ * after starting it can leave the record to another one.
+ */
+int writer_frame(writer_t *w, size_t len);
+
+/*
+ * Marks the end of a record, writing out what is buffered if the policy demands it.
+ * The next call to writer_frame starts a new record.
+ */
+int writer_end_record(writer_t *w);
+
+/*
+ * Writes out whatever is buffered.
+ */
+int writer_flush(writer_t *w);
+
+/*
+ * Writes out whatever is buffered if w is time bounded: meant to be called
+ * when no more records are coming for a while (see buffer_reader_set_idle).
+ */
+int writer_idle(void *w);
+
+#endif // WRITER_H